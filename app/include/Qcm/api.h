@@ -10,6 +10,7 @@
 #include <asio/use_awaitable.hpp>
 
 #include "asio_helper/watch_dog.h"
+#include "core/trace.h"
 #include "ncm/api.h"
 #include "ncm/client.h"
 
@@ -163,6 +164,9 @@ public:
                         auto& self = cnt.self;
                         auto& cli  = cnt.client;
 
+                        qcm::trace::Span span { "api.reload", "api" };
+                        span.set_detail(cnt.api.path());
+
                         ncm::Result<out_type> out = co_await cli.perform(cnt.api);
 
                         if (! out) {
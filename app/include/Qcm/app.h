@@ -26,6 +26,9 @@
 namespace qcm
 {
 class CacheSql;
+class ImageCache;
+class NcmImageProvider;
+class BlobStore;
 
 class App : public QObject {
     Q_OBJECT
@@ -60,6 +63,7 @@ public:
     auto            get_executor() { return m_qt_ex; }
     pool_executor_t get_pool_executor() { return m_pool.get_executor(); }
     auto            get_cache_sql() { return m_cache_sql; }
+    auto            get_image_cache() { return m_image_cache; }
 
     mpris::MediaPlayer2* mpris() const { return m_mpris->mediaplayer2(); }
 
@@ -72,6 +76,7 @@ public:
     Q_INVOKABLE model::ArtistId artistId(QString id) const;
     Q_INVOKABLE model::AlbumId albumId(QString id) const;
     Q_INVOKABLE QUrl           getImageCache(QString url, QSize reqSize) const;
+    Q_INVOKABLE void           prefetchImages(const QStringList& urls, QSizeF reqSize);
     Q_INVOKABLE bool           isItemId(const QJSValue&) const;
     Q_INVOKABLE QString        itemIdPageUrl(const QJSValue&) const;
 
@@ -119,6 +124,10 @@ private:
     rc<CacheSql> m_media_cache_sql;
     rc<CacheSql> m_cache_sql;
 
+    rc<ImageCache>    m_image_cache;
+    rc<BlobStore>     m_blob_store;
+    NcmImageProvider* m_image_provider;
+
     QPointer<QQuickWindow>    m_main_win;
     up<QQmlApplicationEngine> m_qml_engine;
 };
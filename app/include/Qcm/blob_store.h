@@ -0,0 +1,30 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#include "core/core.h"
+
+namespace qcm
+{
+
+// content addressed storage for cache files
+// a cache file is hard linked to blobs/<sha256>, identical payloads share one inode
+// the link count is the reference count, a blob with only its own link is garbage
+class BlobStore : NoCopy {
+public:
+    BlobStore(std::filesystem::path dir);
+    ~BlobStore();
+
+    // hash the finished file and link it with the blob, return the hash
+    std::optional<std::string> adopt(const std::filesystem::path& file);
+
+    // remove blobs no cache file links to
+    usize collect();
+
+private:
+    std::filesystem::path m_dir;
+};
+
+} // namespace qcm
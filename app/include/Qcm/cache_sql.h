@@ -2,10 +2,15 @@
 
 #include "media_cache/database.h"
 #include "core/core.h"
+#include "core/metrics.h"
 
 #include <QSqlDatabase>
+#include <QSqlQuery>
 #include <functional>
+#include <unordered_map>
+#include <unordered_set>
 #include <asio/thread_pool.hpp>
+#include <asio/steady_timer.hpp>
 
 namespace qcm
 {
@@ -14,7 +19,10 @@ class CacheSql : public std::enable_shared_from_this<CacheSql>,
                  public media_cache::DataBase,
                  NoCopy {
 public:
-    using clean_cb_t = std::function<void(std::string_view)>;
+    // evicted keys, called on the cache executor
+    using clean_cb_t = std::function<void(std::vector<std::string>)>;
+    // new entry with its file finished, called on the cache executor
+    using insert_cb_t = std::function<void(const Item&)>;
     CacheSql(std::string_view table, i64 limit);
     ~CacheSql();
 
@@ -22,33 +30,74 @@ public:
 
     void set_limit(i64);
     void set_clean_cb(clean_cb_t);
+    void set_insert_cb(insert_cb_t);
 
     asio::awaitable<std::optional<Item>> get(std::string key) override;
     asio::awaitable<void>                insert(Item) override;
 
     asio::awaitable<void>                remove(std::string key);
+    // erase and persist in one transaction
+    asio::awaitable<void>                remove(std::vector<std::string> keys);
     asio::awaitable<usize>               total_size();
     asio::awaitable<std::optional<Item>> lru();
     asio::awaitable<std::vector<Item>>   get_all();
 
     asio::awaitable<void> try_clean();
 
+    // whether last run shut down cleanly, marks this run as dirty
+    asio::awaitable<bool> take_clean_mark();
+
 private:
+    // in memory index entry, linked in lru order
+    struct Entry {
+        Item   item;
+        i64    timestamp { 0 };
+        Entry* prev { nullptr };
+        Entry* next { nullptr };
+    };
+
     void  try_connect();
     void  trigger_try_clean();
     usize total_size_sync();
     bool  create_table();
     bool  is_reached_limit();
+    void  load_index();
+    void  prepare_queries();
+    bool  set_clean_mark(bool);
+
+    void lru_unlink(Entry&);
+    void lru_push_front(Entry&);
+    void erase_entry(const std::string& key);
+
+    // write-behind
+    void mark_dirty(const std::string& key);
+    void flush();
 
     QString               m_table;
     asio::thread_pool     m_thread;
     asio::any_io_executor m_ex;
     QSqlDatabase          m_db;
+    // prepared once, reused by flush
+    QSqlQuery             m_q_upsert;
+    QSqlQuery             m_q_delete;
     i64                   m_limit;
     double                m_total;
     bool                  m_connected;
 
-    clean_cb_t m_clean_cb;
+    // node based map, entry address is stable
+    std::unordered_map<std::string, Entry> m_index;
+    // most recent at head
+    Entry*                                 m_head;
+    Entry*                                 m_tail;
+
+    std::unordered_set<std::string> m_dirty;
+    asio::steady_timer              m_flush_timer;
+
+    clean_cb_t  m_clean_cb;
+    insert_cb_t m_insert_cb;
+
+    metrics::Counter& m_hits;
+    metrics::Counter& m_misses;
 };
 
 } // namespace qcm
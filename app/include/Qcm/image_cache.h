@@ -0,0 +1,57 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+#include <QImage>
+#include <QString>
+
+#include "core/core.h"
+
+namespace qcm
+{
+
+// decoded images shared by all image requests, lru by byte size
+class ImageCache : NoCopy {
+public:
+    struct Stats {
+        u64   hits;
+        u64   misses;
+        usize bytes;
+        usize count;
+    };
+
+    ImageCache(usize budget);
+    ~ImageCache();
+
+    static QString key(const QString& url, const QSize& size);
+
+    std::optional<QImage> get(const QString& key);
+    // no lru touch, no stats
+    bool                  contains(const QString& key) const;
+    void                  insert(const QString& key, const QImage&);
+    void                  set_budget(usize);
+    void                  clear();
+    Stats                 stats() const;
+
+private:
+    struct Entry {
+        QString key;
+        QImage  image;
+    };
+    using list_type = std::list<Entry>;
+
+    void evict();
+
+    mutable std::mutex                               m_mutex;
+    list_type                                        m_lru;
+    std::unordered_map<QString, list_type::iterator> m_map;
+    usize                                            m_budget;
+    usize                                            m_bytes;
+    u64                                              m_hits;
+    u64                                              m_misses;
+};
+
+} // namespace qcm
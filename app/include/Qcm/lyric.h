@@ -7,14 +7,36 @@
 namespace qcm
 {
 
+class LrcLyricWord {
+    Q_GADGET
+public:
+    Q_PROPERTY(qlonglong milliseconds MEMBER milliseconds)
+    Q_PROPERTY(qlonglong duration MEMBER duration)
+    Q_PROPERTY(QString content MEMBER content)
+
+    qlonglong milliseconds;
+    qlonglong duration;
+    QString   content;
+};
+
 class LrcLyricLine {
     Q_GADGET
 public:
     Q_PROPERTY(qlonglong milliseconds MEMBER milliseconds)
+    Q_PROPERTY(qlonglong duration MEMBER duration)
     Q_PROPERTY(QString content MEMBER content)
+    Q_PROPERTY(QString translation MEMBER translation)
+    Q_PROPERTY(QString romanization MEMBER romanization)
+    Q_PROPERTY(QList<LrcLyricWord> words MEMBER words)
 
     qlonglong milliseconds;
+    // 0 for unknown, the last lrc line
+    qlonglong duration { 0 };
     QString   content;
+    QString   translation;
+    QString   romanization;
+    // only from word timed source
+    QList<LrcLyricWord> words;
 };
 
 class LrcLyric : public meta_model::QGadgetListModel<LrcLyricLine> {
@@ -22,22 +44,47 @@ class LrcLyric : public meta_model::QGadgetListModel<LrcLyricLine> {
     QML_ELEMENT
 
     Q_PROPERTY(qlonglong currentIndex READ currentIndex NOTIFY currentIndexChanged)
+    Q_PROPERTY(qlonglong currentWordIndex READ currentWordIndex NOTIFY currentWordIndexChanged)
+    Q_PROPERTY(qreal progress READ progress NOTIFY progressChanged)
+    Q_PROPERTY(qreal wordProgress READ wordProgress NOTIFY progressChanged)
     Q_PROPERTY(qlonglong position READ position WRITE setPosition NOTIFY positionChanged)
     Q_PROPERTY(QString source READ source WRITE setSource NOTIFY sourceChanged)
+    Q_PROPERTY(QString translation READ translation WRITE setTranslation NOTIFY sourceChanged)
+    Q_PROPERTY(
+        QString romanization READ romanization WRITE setRomanization NOTIFY sourceChanged)
+    Q_PROPERTY(QString wordSource READ wordSource WRITE setWordSource NOTIFY sourceChanged)
 public:
     LrcLyric(QObject* = nullptr);
     ~LrcLyric();
 
+    struct Sources {
+        QString lrc;
+        QString trans;
+        QString roma;
+        QString yrc;
+    };
+
     QString source() const;
     void    setSource(QString);
+    QString translation() const;
+    void    setTranslation(QString);
+    QString romanization() const;
+    void    setRomanization(QString);
+    QString wordSource() const;
+    void    setWordSource(QString);
 
     qlonglong position() const;
-    void setPosition(qlonglong);
+    void      setPosition(qlonglong);
 
     qlonglong currentIndex() const;
+    qlonglong currentWordIndex() const;
+    qreal     progress() const;
+    qreal     wordProgress() const;
 
 signals:
     void currentIndexChanged();
+    void currentWordIndexChanged();
+    void progressChanged();
     void positionChanged();
     void sourceChanged();
 
@@ -47,9 +94,22 @@ private slots:
     void setCurrentIndex(qlonglong);
 
 private:
+    void set_source(QString Sources::*, QString);
+    void apply_lines(std::vector<LrcLyricLine>&&);
+    void refresh_word(qlonglong pos);
+
     qlonglong m_cur_idx;
+    qlonglong m_cur_word;
     qlonglong m_position;
-    QString   m_source;
+    qreal     m_progress;
+    qreal     m_word_progress;
+    Sources   m_sources;
+    // drop results of outdated parse
+    quint64   m_parse_id;
+    bool      m_parse_pending;
+
+    // sorted line start times, same order as model rows
+    std::vector<qlonglong> m_times;
 };
 
 } // namespace qcm
@@ -20,6 +20,7 @@ public:
     READ_PROPERTY(QString, lrc, m_lrc, infoChanged)
     READ_PROPERTY(QString, transLrc, m_trans_lrc, infoChanged)
     READ_PROPERTY(QString, romaLrc, m_roma_lrc, infoChanged)
+    READ_PROPERTY(QString, yrc, m_yrc, infoChanged)
 
     using out_type = ncm::api_model::SongLyric;
     void handle_output(const out_type& in, const auto&) {
@@ -32,6 +33,10 @@ public:
         if (in.romalrc) {
             convert(m_roma_lrc, in.romalrc->lyric);
         }
+        m_yrc.clear();
+        if (in.yrc) {
+            convert(m_yrc, in.yrc->lyric);
+        }
         emit infoChanged();
     }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <filesystem>
+#include <functional>
 
 #include <QQuickImageProvider>
 #include <QQuickAsyncImageProvider>
@@ -28,6 +29,8 @@ public:
     QString errorString() const override { return m_error; }
 
     helper::WatchDog& wdog() { return m_wdog; }
+    // called once when cancelled or destroyed
+    void              set_cancel_cb(std::function<void()>);
 
 public slots:
     void handle(QImage img) {
@@ -38,16 +41,15 @@ public slots:
         m_error = error;
         emit finished();
     }
-    void cancel() override {
-        m_wdog.cancel();
-        emit finished();
-    }
+    void cancel() override;
 
 private:
     QImage           m_image_;
     QImage           m_image;
     QString          m_error;
     helper::WatchDog m_wdog;
+
+    std::function<void()> m_cancel_cb;
 };
 
 class NcmImageProviderInner;
@@ -59,6 +61,9 @@ public:
     QQuickImageResponse* requestImageResponse(const QString& id,
                                               const QSize&   requestedSize) override;
 
+    // warm the caches for an image likely to be shown soon
+    void prefetch(const QString& id, const QSize& requestedSize);
+
     static request::Request makeReq(const QString& id, const QSize& requestedSize, ncm::Client&);
     static std::filesystem::path genImageCachePath(const request::Request&);
 
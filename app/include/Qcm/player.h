@@ -17,6 +17,7 @@ class Player : public QObject {
     Q_PROPERTY(int position READ position WRITE set_position NOTIFY positionChanged)
     Q_PROPERTY(int duration READ duration NOTIFY durationChanged)
     Q_PROPERTY(PlaybackState playbackState READ playbackState NOTIFY playbackStateChanged)
+    Q_PROPERTY(float volume READ volume WRITE set_volume NOTIFY volumeChanged)
 public:
     using NotifyInfo   = player::notify::info;
     using channel_type = asio::experimental::concurrent_channel<asio::thread_pool::executor_type,
@@ -38,10 +39,14 @@ public:
     int           position() const;
     int           duration() const;
     PlaybackState playbackState() const;
+    float         volume() const;
+    void          set_volume(float);
 
     Q_INVOKABLE void play();
     Q_INVOKABLE void pause();
     Q_INVOKABLE void stop();
+    // underruns and callback timing of the audio device
+    Q_INVOKABLE QVariantMap deviceStats() const;
 
     void set_position(int);
 
@@ -55,6 +60,7 @@ signals:
     void positionChanged();
     void durationChanged();
     void playbackStateChanged();
+    void volumeChanged();
     void notify(NotifyInfo);
 
 public slots:
@@ -2,6 +2,10 @@
 
 #include <QQmlEngine>
 #include <QAbstractListModel>
+#include <QTimer>
+
+#include <unordered_map>
+#include <asio/any_io_executor.hpp>
 
 #include "Qcm/model.h"
 
@@ -39,6 +43,8 @@ public:
     Q_ENUM(Role)
 
     struct CurGuard;
+    struct Batch;
+    struct Snapshot;
 
     Playlist(QObject* parent = nullptr);
     ~Playlist();
@@ -63,6 +69,7 @@ signals:
     void loopModeChanged();
     void canMoveChanged();
     void end();
+    void restored(qint64 position);
 
 public slots:
     void switchList(const std::vector<model::Song>&);
@@ -76,29 +83,57 @@ public slots:
     void appendNext(const model::Song&);
     void appendList(const std::vector<model::Song>&);
 
+    // queue append/appendNext/remove until commit, then notify once
+    void beginBatch();
+    void commitBatch();
+
+    // load the queue snapshot written on last run
+    void restore();
+    void recordPosition(qint64);
+
 private slots:
     void setCanNext(bool);
     void setCanPrev(bool);
     void check_cur(bool refresh = false);
     void RefreshCanMove();
+    void schedule_snapshot();
+    void schedule_cursor();
+    void write_snapshot();
+    void write_cursor();
 
 private:
     template<typename T>
         requires std::ranges::sized_range<T> &&
                  std::convertible_to<std::ranges::range_value_t<T>, model::Song>
     usize insert(int index, const T& range);
+    template<typename T>
+        requires std::ranges::sized_range<T> &&
+                 std::convertible_to<std::ranges::range_value_t<T>, model::Song>
+    std::vector<QString> insert_songs(const T& range);
+    void                 insert_ids(int index, const std::vector<QString>& ids);
+    void                 remove_id(const QString&);
+
+    void flush_batch();
+    void apply_batch(const Batch&);
+    void apply_snapshot(Snapshot&&);
 
     const detail::PlayList& oper_list() const;
     const detail::PlayList& sync_list() const;
     detail::PlayList&       oper_list();
     detail::PlayList&       sync_list();
 
-    model::Song                    m_cur;
-    std::map<QString, model::Song> m_songs;
-    up<detail::PlayList>           m_list;
-    up<detail::PlayList>           m_shuffle_list;
-    LoopMode                       m_loop_mode;
-    bool                           m_can_next;
-    bool                           m_can_prev;
+    model::Song                              m_cur;
+    std::unordered_map<QString, model::Song> m_songs;
+    up<detail::PlayList>                     m_list;
+    up<detail::PlayList>                     m_shuffle_list;
+    LoopMode                                 m_loop_mode;
+    bool                                     m_can_next;
+    bool                                     m_can_prev;
+    up<Batch>                                m_batch;
+
+    QTimer                m_snapshot_timer;
+    QTimer                m_cursor_timer;
+    asio::any_io_executor m_snapshot_ex;
+    qint64                m_position;
 };
 } // namespace qcm
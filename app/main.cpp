@@ -7,6 +7,7 @@
 #include "Qcm/app.h"
 #include "request/request.h"
 #include "core/log.h"
+#include "core/trace.h"
 
 #include <QtQml/QQmlExtensionPlugin>
 Q_IMPORT_QML_PLUGIN(Qcm_AppPlugin)
@@ -16,6 +17,7 @@ Q_IMPORT_QML_PLUGIN(Qcm_MaterialPlugin)
 
 int main(int argc, char* argv[]) {
     auto logger = qcm::LogManager::init();
+    logger->start_async();
     request::global_init();
 
     QGuiApplication gui_app(argc, argv);
@@ -24,13 +26,40 @@ int main(int argc, char* argv[]) {
     QCoreApplication::setApplicationVersion(APP_VERSION);
 
     QCommandLineParser parser;
+    std::string        trace_path;
     {
         parser.addHelpOption();
         parser.addVersionOption();
         QCommandLineOption verboseOption("verbose");
+        QCommandLineOption logFileOption("log-file", "Also write log to <file>.", "file");
+        QCommandLineOption logBinaryOption(
+            "log-binary", "Also write binary log to <file>, see qcm_log_decode.", "file");
+        QCommandLineOption traceOption(
+            "trace", "Write a chrome trace to <file> on exit, see ui.perfetto.dev.", "file");
         parser.addOption(verboseOption);
+        parser.addOption(logFileOption);
+        parser.addOption(logBinaryOption);
+        parser.addOption(traceOption);
         parser.process(gui_app);
 
+        if (parser.isSet(logFileOption)) {
+            auto path = parser.value(logFileOption).toStdString();
+            if (! logger->set_file_sink(path, 8 * 1024 * 1024, 3)) {
+                WARN_LOG("can't open log file {}", path);
+            }
+        }
+        if (parser.isSet(logBinaryOption)) {
+            auto path = parser.value(logBinaryOption).toStdString();
+            if (! logger->set_binary_sink(path)) {
+                WARN_LOG("can't open binary log file {}", path);
+            }
+        }
+
+        if (parser.isSet(traceOption)) {
+            trace_path = parser.value(traceOption).toStdString();
+            qcm::trace::start();
+        }
+
         logger->set_level(parser.isSet(verboseOption) ? qcm::LogLevel::DEBUG : qcm::LogLevel::WARN);
         QLoggingCategory::setFilterRules(
             QString::fromStdString(fmt::format("qcm.debug={}", parser.isSet(verboseOption))));
@@ -57,5 +86,9 @@ int main(int argc, char* argv[]) {
         re = gui_app.exec();
     }
 
+    if (! trace_path.empty() && ! qcm::trace::stop(trace_path)) {
+        WARN_LOG("can't write trace file {}", trace_path);
+    }
+
     return re;
 }
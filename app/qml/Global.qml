@@ -147,6 +147,7 @@ Item {
         id: m_playlist
 
         property var song_url_slot: null
+        property int resume_position: 0
 
         function iterLoopMode() {
             let mode = loopMode;
@@ -208,6 +209,10 @@ Item {
                     m_querier_song.ids = [songId];
             }
         }
+        onRestored: function (position) {
+            resume_position = position;
+        }
+        Component.onCompleted: restore()
     }
     QA.UserAccountQuerier {
         id: m_querier_user
@@ -284,6 +289,13 @@ Item {
         }
 
         source: ''
+        onPositionChanged: m_playlist.recordPosition(position)
+        onDurationChanged: {
+            if (m_playlist.resume_position > 0 && duration > 0) {
+                position = m_playlist.resume_position;
+                m_playlist.resume_position = 0;
+            }
+        }
         onSourceChanged: {
             if (source) {
                 play();
@@ -15,4 +15,36 @@ MD.GridView {
     rightMargin: space / 2
     cellHeight: fixedCellWidth + 100
     cellWidth: _width > 0 ? _width / Math.floor((_width / (fixedCellWidth + space / 2))) : 0
+
+    // prefetch images of the rows below the viewport
+    property int prefetchRows: 2
+    property string prefetchRole: 'picUrl'
+    property size prefetchSize: Qt.size(fixedCellWidth, fixedCellWidth)
+
+    function prefetch() {
+        if (!model || !model.item || cellWidth <= 0 || cellHeight <= 0)
+            return;
+        const cols = Math.max(1, Math.floor(width / cellWidth));
+        const rows_end = Math.ceil((contentY - originY + height) / cellHeight);
+        const begin = rows_end * cols;
+        const end = Math.min(count, begin + prefetchRows * cols);
+        const urls = [];
+        for (let i = begin; i < end; i++) {
+            const it = model.item(i);
+            const url = it ? it[prefetchRole] : null;
+            if (url)
+                urls.push(url);
+        }
+        if (urls.length)
+            QA.App.prefetchImages(urls, QA.App.image_size(prefetchSize, QA.Global.cover_quality, root));
+    }
+
+    onContentYChanged: timer_prefetch.restart()
+    onCountChanged: timer_prefetch.restart()
+
+    Timer {
+        id: timer_prefetch
+        interval: 150
+        onTriggered: root.prefetch()
+    }
 }
@@ -29,10 +29,6 @@ MD.Page {
     QA.SongLyricQuerier {
         id: querier_lyric
 
-        readonly property string combined_lrc: {
-            return data.lrc + data.transLrc;
-        }
-
         autoReload: songId.valid()
         songId: QA.Global.cur_song.itemId
     }
@@ -163,7 +159,10 @@ MD.Page {
                     QA.LrcLyric {
                         id: lrc
                         position: QA.Global.player.position
-                        source: querier_lyric.combined_lrc
+                        source: querier_lyric.data.lrc
+                        translation: querier_lyric.data.transLrc
+                        romanization: querier_lyric.data.romaLrc
+                        wordSource: querier_lyric.data.yrc
 
                         onCurrentIndexChanged: {
                             lyric_view.posTo(currentIndex < 0 ? 0 : currentIndex);
@@ -248,6 +247,16 @@ MD.Page {
                                         color: parent.current ? MD.Token.color.primary : MD.Token.color.on_surface
                                         maximumLineCount: -1
                                     }
+                                    MD.Text {
+                                        Layout.fillWidth: true
+                                        visible: text.length > 0
+                                        typescale: MD.Token.typescale.title_medium
+                                        horizontalAlignment: Text.AlignHCenter
+                                        verticalAlignment: Text.AlignVCenter
+                                        text: model.translation
+                                        color: parent.current ? MD.Token.color.primary : MD.Token.color.on_surface_variant
+                                        maximumLineCount: -1
+                                    }
                                 }
 
                                 onClicked: {
@@ -2,6 +2,7 @@
 
 #include <cmath>
 #include <array>
+#include <unordered_set>
 
 #include <QQuickWindow>
 #include <QQuickStyle>
@@ -11,7 +12,10 @@
 #include <QJSValueIterator>
 #include <QQuickItem>
 
+#include <asio/bind_executor.hpp>
 #include <asio/deferred.hpp>
+#include <asio/post.hpp>
+#include <asio/use_awaitable.hpp>
 
 #include "Qcm/path.h"
 #include "Qcm/type.h"
@@ -21,6 +25,8 @@
 #include "crypto/crypto.h"
 #include "Qcm/info.h"
 #include "Qcm/cache_sql.h"
+#include "Qcm/image_cache.h"
+#include "Qcm/blob_store.h"
 
 #include "request/response.h"
 #include "asio_helper/sync_file.h"
@@ -33,24 +39,73 @@ using namespace qcm;
 namespace
 {
 
+constexpr usize DefImageCacheBudget { 128 * 1024 * 1024 };
+
+// delete evicted files off the cache executor
+CacheSql::clean_cb_t remove_cache_files(asio::any_io_executor ex, std::filesystem::path dir,
+                                        rc<BlobStore> blobs) {
+    return [ex, dir, blobs](std::vector<std::string> keys) {
+        asio::post(ex, [dir, blobs, keys = std::move(keys)]() {
+            for (auto& key : keys) {
+                auto            file = dir / key;
+                std::error_code ec;
+                std::filesystem::remove(file, ec);
+                DEBUG_LOG("cache remove {}", file.native());
+            }
+            if (blobs) blobs->collect();
+        });
+    };
+}
+
+// move finished files into the blob store
+CacheSql::insert_cb_t adopt_cache_file(asio::any_io_executor ex, std::filesystem::path dir,
+                                       rc<BlobStore> blobs) {
+    return [ex, dir, blobs](const CacheSql::Item& item) {
+        asio::post(ex, [file = dir / item.key, blobs]() {
+            blobs->adopt(file);
+        });
+    };
+}
+
 asio::awaitable<void> scan_media_cache(rc<CacheSql> cache_sql, std::filesystem::path cache_dir) {
-    auto                  cache_entries = co_await cache_sql->get_all();
-    std::set<std::string> keys, files;
-    for (auto& el : cache_entries) keys.insert(el.key);
-    for (auto& el : std::filesystem::directory_iterator(cache_dir))
-        files.insert(el.path().filename());
-
-    for (auto& k : keys) {
-        if (! files.contains(k)) {
-            co_await cache_sql->remove(k);
-        }
+    // cache_sql calls resume on its own executor
+    auto pool_ex = co_await asio::this_coro::executor;
+
+    // index and files are in sync after a clean shutdown
+    if (co_await cache_sql->take_clean_mark()) {
+        co_await cache_sql->try_clean();
+        co_return;
     }
 
-    for (auto& f : files) {
-        if (! keys.contains(f)) {
-            std::filesystem::remove(cache_dir / f);
+    auto                            scan_start = std::filesystem::file_time_type::clock::now();
+    std::unordered_set<std::string> keys;
+    for (auto& el : co_await cache_sql->get_all()) keys.insert(std::move(el.key));
+
+    // walk the directory off the cache executor, lookups keep going meanwhile
+    co_await asio::post(asio::bind_executor(pool_ex, asio::use_awaitable));
+
+    // stream the directory, anything left in keys has no file
+    std::error_code ec;
+    for (auto it = std::filesystem::directory_iterator(cache_dir, ec);
+         ! ec && it != std::filesystem::directory_iterator();
+         it.increment(ec)) {
+        auto name = it->path().filename().native();
+        if (keys.erase(name) == 0) {
+            // written after the scan started, owned by a running download
+            std::error_code rm_ec;
+            auto            mtime = it->last_write_time(rm_ec);
+            if (! rm_ec && mtime >= scan_start) continue;
+            std::filesystem::remove(it->path(), rm_ec);
         }
     }
+    if (ec) {
+        ERROR_LOG("scan {} failed: {}", cache_dir.native(), ec.message());
+        co_return;
+    }
+
+    if (! keys.empty()) {
+        co_await cache_sql->remove(std::vector<std::string> { keys.begin(), keys.end() });
+    }
 
     co_await cache_sql->try_clean();
     co_return;
@@ -70,6 +125,7 @@ App::App()
       m_client(m_session, m_pool.get_executor()),
       m_mpris(std::make_unique<mpris::Mpris>()),
       m_media_cache(std::make_shared<media_cache::MediaCache>(m_pool.get_executor(), m_session)),
+      m_image_provider(nullptr),
       m_main_win(nullptr),
       m_qml_engine(std::make_unique<QQmlApplicationEngine>()) {
     _assert_msg_rel_(self == nullptr, "there should be only one app object");
@@ -84,11 +140,21 @@ App::App()
 
     m_media_cache_sql = std::make_shared<CacheSql>("media_cache", 0);
     m_cache_sql       = std::make_shared<CacheSql>("cache", 0);
+    m_image_cache     = std::make_shared<ImageCache>(DefImageCacheBudget);
 }
 App::~App() {
-    m_qml_engine = nullptr;
+    m_image_provider = nullptr;
+    m_qml_engine     = nullptr;
 
     save_session();
+    {
+        auto s = m_image_cache->stats();
+        DEBUG_LOG("image cache, hit: {}, miss: {}, {} images, {} bytes",
+                  s.hits,
+                  s.misses,
+                  s.count,
+                  s.bytes);
+    }
     m_media_cache->stop();
     m_session->about_to_stop();
     m_pool.join();
@@ -112,29 +178,42 @@ void App::init() { // QQmlApplicationEngine* engine) {
             "Qcm.App", 1, 0, "MprisMediaPlayer", "uncreatable");
     }
 
+    {
+        // content addressed dedup for cache files, off by default
+        QSettings s;
+        if (s.value("cache/dedup", false).toBool()) {
+            m_blob_store = std::make_shared<BlobStore>(cache_path() / "blobs");
+            asio::post(m_pool, [blobs = m_blob_store]() {
+                blobs->collect();
+            });
+        }
+    }
+
     {
         auto cache_dir = cache_path() / "cache";
-        m_cache_sql->set_clean_cb([cache_dir](std::string_view key) {
-            auto file = cache_dir / key;
-            std::filesystem::remove(file);
-            DEBUG_LOG("cache remove {}", file.native());
-        });
-        asio::co_spawn(
-            m_cache_sql->get_executor(), scan_media_cache(m_cache_sql, cache_dir), asio::detached);
+        m_cache_sql->set_clean_cb(
+            remove_cache_files(m_pool.get_executor(), cache_dir, m_blob_store));
+        if (m_blob_store)
+            m_cache_sql->set_insert_cb(
+                adopt_cache_file(m_pool.get_executor(), cache_dir, m_blob_store));
+        asio::co_spawn(m_pool, scan_media_cache(m_cache_sql, cache_dir), asio::detached);
     }
 
     {
         auto media_cache_dir = cache_path() / "media";
-        m_media_cache_sql->set_clean_cb([media_cache_dir](std::string_view key) {
-            auto file = media_cache_dir / key;
-            std::filesystem::remove(file);
-            DEBUG_LOG("cache remove {}", file.native());
-        });
+        m_media_cache_sql->set_clean_cb(
+            remove_cache_files(m_pool.get_executor(), media_cache_dir, m_blob_store));
+        if (m_blob_store)
+            m_media_cache_sql->set_insert_cb(
+                adopt_cache_file(m_pool.get_executor(), media_cache_dir, m_blob_store));
 
-        m_media_cache->start(media_cache_dir, m_media_cache_sql);
-        asio::co_spawn(m_media_cache_sql->get_executor(),
-                       scan_media_cache(m_media_cache_sql, media_cache_dir),
-                       asio::detached);
+        // fixed port for metrics scraping, 0 for any
+        QSettings s;
+        auto      port = (u16)s.value("media_cache/port", 0).toUInt();
+        m_media_cache->start(media_cache_dir, m_media_cache_sql, port);
+        INFO_LOG("metrics at {}", m_media_cache->metrics_url());
+        asio::co_spawn(
+            m_pool, scan_media_cache(m_media_cache_sql, media_cache_dir), asio::detached);
     }
     triggerCacheLimit();
 
@@ -146,7 +225,9 @@ void App::init() { // QQmlApplicationEngine* engine) {
 
     connect(engine, &QQmlApplicationEngine::quit, gui_app, &QGuiApplication::quit);
 
-    engine->addImageProvider(u"ncm"_qs, new NcmImageProvider {});
+    // owned by engine
+    m_image_provider = new NcmImageProvider {};
+    engine->addImageProvider(u"ncm"_qs, m_image_provider);
     engine->addImageProvider(u"qr"_qs, new QrImageProvider {});
 
     engine->load(u"qrc:/main/main.qml"_qs);
@@ -169,6 +250,13 @@ QUrl App::getImageCache(QString url, QSize reqSize) const {
     return QUrl::fromLocalFile(path.native().c_str());
 }
 
+void App::prefetchImages(const QStringList& urls, QSizeF reqSize) {
+    if (! m_image_provider) return;
+    for (auto& url : urls) {
+        m_image_provider->prefetch(url, reqSize.toSize());
+    }
+}
+
 QUrl App::media_file(const QString& id_) const {
     auto id              = convert_from<std::string>(id_);
     auto media_cache_dir = cache_path() / "media";
@@ -321,6 +409,7 @@ void App::releaseResources(QQuickWindow* win) {
     m_qml_engine->trimComponentCache();
     m_qml_engine->collectGarbage();
     win->releaseResources();
+    m_image_cache->clear();
     // QQuickPixmap::purgeCache();
     plt::malloc_trim(0);
 }
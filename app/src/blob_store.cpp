@@ -0,0 +1,75 @@
+#include "Qcm/blob_store.h"
+
+#include <QCryptographicHash>
+#include <QFile>
+
+#include "core/log.h"
+
+using namespace qcm;
+
+namespace
+{
+std::optional<std::string> hash_file(const std::filesystem::path& p) {
+    QFile file(QString::fromStdString(p.native()));
+    if (! file.open(QIODevice::ReadOnly)) return std::nullopt;
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    if (! hash.addData(&file)) return std::nullopt;
+    return hash.result().toHex().toStdString();
+}
+} // namespace
+
+BlobStore::BlobStore(std::filesystem::path dir): m_dir(dir) {
+    std::error_code ec;
+    std::filesystem::create_directories(m_dir, ec);
+}
+BlobStore::~BlobStore() {}
+
+std::optional<std::string> BlobStore::adopt(const std::filesystem::path& file) {
+    auto hash = hash_file(file);
+    if (! hash) return std::nullopt;
+
+    auto            blob = m_dir / hash.value();
+    std::error_code ec;
+    if (std::filesystem::equivalent(file, blob, ec)) return hash;
+
+    if (std::filesystem::exists(blob, ec) &&
+        std::filesystem::file_size(blob, ec) == std::filesystem::file_size(file, ec)) {
+        // same content stored, point the file to it
+        auto tmp = file;
+        tmp.replace_extension("blob");
+        std::filesystem::remove(tmp, ec);
+        std::filesystem::create_hard_link(blob, tmp, ec);
+        if (! ec) std::filesystem::rename(tmp, file, ec);
+        if (ec) {
+            std::filesystem::remove(tmp, ec);
+            WARN_LOG("link {} to blob failed: {}", file.native(), ec.message());
+            return std::nullopt;
+        }
+        DEBUG_LOG("dedup {} -> {}", file.native(), hash.value());
+    } else {
+        std::filesystem::remove(blob, ec);
+        std::filesystem::create_hard_link(file, blob, ec);
+        if (ec) {
+            // e.g. different filesystem, keep the plain file
+            WARN_LOG("create blob for {} failed: {}", file.native(), ec.message());
+            return std::nullopt;
+        }
+    }
+    return hash;
+}
+
+usize BlobStore::collect() {
+    usize           removed { 0 };
+    std::error_code ec;
+    for (auto it = std::filesystem::directory_iterator(m_dir, ec);
+         ! ec && it != std::filesystem::directory_iterator();
+         it.increment(ec)) {
+        std::error_code link_ec;
+        if (it->hard_link_count(link_ec) == 1 && ! link_ec) {
+            if (std::filesystem::remove(it->path(), link_ec)) removed++;
+        }
+    }
+    if (removed) DEBUG_LOG("collect {} blobs", removed);
+    return removed;
+}
@@ -4,12 +4,15 @@
 #include <asio/bind_executor.hpp>
 #include <asio/co_spawn.hpp>
 #include <asio/detached.hpp>
+#include <asio/post.hpp>
 
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QSqlRecord>
 #include <QDateTime>
 
+#include <array>
+
 #include "Qcm/path.h"
 #include "Qcm/type.h"
 #include "core/log.h"
@@ -28,6 +31,26 @@ CacheSql::Item query_to_item(const QSqlQuery& q) {
         .content_length = q.value(i_content_length).toULongLong(),
     };
 }
+
+// batch timestamp updates and inserts into one transaction
+constexpr auto FlushDelay = std::chrono::seconds(2);
+
+// connection profile, wal lets the two connections on cache.db read while writing
+constexpr std::array ConnectPragmas {
+    "PRAGMA journal_mode = WAL;",
+    "PRAGMA synchronous = NORMAL;",
+    "PRAGMA mmap_size = 67108864;",
+    "PRAGMA busy_timeout = 5000;",
+    "PRAGMA temp_store = MEMORY;",
+};
+
+// schema version n is reached by running Migrations[n-1], %1 is the table name
+// append only, never edit a released step
+constexpr std::array<std::string_view, 2> Migrations {
+    "CREATE TABLE IF NOT EXISTS %1 (key text not null primary key, "
+    "content_type text, content_length integer, timestamp integer);",
+    "CREATE INDEX IF NOT EXISTS %1_timestamp ON %1 (timestamp);",
+};
 } // namespace
 
 CacheSql::CacheSql(std::string_view table, i64 limit)
@@ -35,13 +58,33 @@ CacheSql::CacheSql(std::string_view table, i64 limit)
       m_thread(1),
       m_ex(m_thread.get_executor()),
       m_limit(limit),
-      m_connected(false) {
+      m_total(0),
+      m_connected(false),
+      m_head(nullptr),
+      m_tail(nullptr),
+      m_flush_timer(m_ex),
+      m_hits(metrics::counter(
+          fmt::format("qcm_cache_lookups_total{{table=\"{}\",result=\"hit\"}}", table),
+          "Cache index lookups.")),
+      m_misses(metrics::counter(
+          fmt::format("qcm_cache_lookups_total{{table=\"{}\",result=\"miss\"}}", table),
+          "Cache index lookups.")) {
     asio::dispatch(m_ex, [this]() {
         try_connect();
     });
 }
 
-CacheSql::~CacheSql() {}
+CacheSql::~CacheSql() {
+    asio::post(m_ex, [this]() {
+        m_flush_timer.cancel();
+        flush();
+        set_clean_mark(true);
+        // release statements on the connection thread
+        m_q_upsert = QSqlQuery();
+        m_q_delete = QSqlQuery();
+    });
+    m_thread.join();
+}
 
 bool CacheSql::is_reached_limit() { return m_limit > 0 && m_total > m_limit; }
 
@@ -51,7 +94,13 @@ void CacheSql::try_connect() {
         auto p = (data_path() / "cache.db");
         m_db.setDatabaseName(p.native().c_str());
         if (m_db.open()) {
+            for (auto p : ConnectPragmas) {
+                QSqlQuery q(m_db);
+                if (! q.exec(p)) ERROR_LOG("{}", q.lastError().text());
+            }
             create_table();
+            load_index();
+            prepare_queries();
             m_total = total_size_sync();
         } else {
             ERROR_LOG("{}", m_db.lastError().text());
@@ -62,13 +111,172 @@ void CacheSql::try_connect() {
 }
 
 bool CacheSql::create_table() {
+    {
+        QSqlQuery q(m_db);
+        if (! q.exec("CREATE TABLE IF NOT EXISTS schema_version (name text not null primary key, "
+                     "version integer);")) {
+            ERROR_LOG("{}", q.lastError().text());
+            return false;
+        }
+    }
+
+    int version { 0 };
+    {
+        QSqlQuery q(m_db);
+        q.prepare("SELECT version FROM schema_version WHERE name = :name");
+        q.bindValue(":name", m_table);
+        if (q.exec() && q.next()) version = q.value(0).toInt();
+    }
+
+    for (int v = version; v < (int)Migrations.size(); v++) {
+        m_db.transaction();
+        QSqlQuery q(m_db);
+        bool      ok = q.exec(QString::fromUtf8(Migrations[v].data(), Migrations[v].size())
+                                  .arg(m_table));
+        if (ok) {
+            q.prepare("INSERT OR REPLACE INTO schema_version (name, version) VALUES (:name, "
+                      ":version);");
+            q.bindValue(":name", m_table);
+            q.bindValue(":version", v + 1);
+            ok = q.exec();
+        }
+        if (! ok || ! m_db.commit()) {
+            ERROR_LOG("migrate {} to {} failed: {}", m_table, v + 1, q.lastError().text());
+            m_db.rollback();
+            return false;
+        }
+        INFO_LOG("migrate {} to {}", m_table, v + 1);
+    }
+    return true;
+}
+
+bool CacheSql::set_clean_mark(bool clean) {
+    if (! m_db.isOpen()) return false;
     QSqlQuery q(m_db);
-    q.prepare(QString("CREATE TABLE IF NOT EXISTS %1 (key text not null primary key, "
-                      "content_type text, content_length integer, timestamp integer);")
-                  .arg(m_table));
+    if (! q.exec("CREATE TABLE IF NOT EXISTS shutdown_state (name text not null primary key, "
+                 "clean integer);"))
+        return false;
+    q.prepare("INSERT OR REPLACE INTO shutdown_state (name, clean) VALUES (:name, :clean);");
+    q.bindValue(":name", m_table);
+    q.bindValue(":clean", clean ? 1 : 0);
     return q.exec();
 }
 
+asio::awaitable<bool> CacheSql::take_clean_mark() {
+    co_await asio::post(asio::bind_executor(m_ex, asio::use_awaitable));
+    try_connect();
+
+    bool clean { false };
+    {
+        QSqlQuery q(m_db);
+        q.prepare("SELECT clean FROM shutdown_state WHERE name = :name");
+        q.bindValue(":name", m_table);
+        if (q.exec() && q.next()) clean = q.value(0).toInt() == 1;
+    }
+    // dirty until the destructor runs
+    set_clean_mark(false);
+    co_return clean;
+}
+
+void CacheSql::prepare_queries() {
+    m_q_upsert = QSqlQuery(m_db);
+    m_q_upsert.prepare(
+        QString("INSERT OR REPLACE INTO %1 (key, content_type, content_length, timestamp) "
+                "VALUES (:key, :content_type, :content_length, :timestamp);")
+            .arg(m_table));
+    m_q_delete = QSqlQuery(m_db);
+    m_q_delete.prepare(QString("DELETE FROM %1 WHERE key = :key").arg(m_table));
+}
+
+void CacheSql::load_index() {
+    QSqlQuery q(m_db);
+    q.setForwardOnly(true);
+    q.prepare(QString("SELECT * FROM %1 ORDER BY timestamp DESC").arg(m_table));
+    if (! q.exec()) {
+        ERROR_LOG("{}", q.lastError().text());
+        return;
+    }
+    auto i_timestamp = q.record().indexOf("timestamp");
+    while (q.next()) {
+        auto item = query_to_item(q);
+        auto key  = item.key;
+        auto [it, ok] =
+            m_index.try_emplace(key, Entry { .item = std::move(item),
+                                             .timestamp = q.value(i_timestamp).toLongLong() });
+        if (! ok) continue;
+
+        // rows come newest first, append to tail
+        auto& e = it->second;
+        e.prev  = m_tail;
+        if (m_tail) m_tail->next = &e;
+        m_tail = &e;
+        if (! m_head) m_head = &e;
+    }
+}
+
+void CacheSql::lru_unlink(Entry& e) {
+    if (e.prev) e.prev->next = e.next;
+    if (e.next) e.next->prev = e.prev;
+    if (m_head == &e) m_head = e.next;
+    if (m_tail == &e) m_tail = e.prev;
+    e.prev = e.next = nullptr;
+}
+
+void CacheSql::lru_push_front(Entry& e) {
+    e.prev = nullptr;
+    e.next = m_head;
+    if (m_head) m_head->prev = &e;
+    m_head = &e;
+    if (! m_tail) m_tail = &e;
+}
+
+void CacheSql::erase_entry(const std::string& key) {
+    if (auto it = m_index.find(key); it != m_index.end()) {
+        m_total -= it->second.item.content_length / 1024.0;
+        lru_unlink(it->second);
+        m_index.erase(it);
+        mark_dirty(key);
+    }
+}
+
+void CacheSql::mark_dirty(const std::string& key) {
+    // first pending change arms the timer
+    if (m_dirty.insert(key).second && m_dirty.size() == 1) {
+        m_flush_timer.expires_after(FlushDelay);
+        m_flush_timer.async_wait([this](const asio::error_code& ec) {
+            if (ec) return;
+            flush();
+        });
+    }
+}
+
+void CacheSql::flush() {
+    if (m_dirty.empty() || ! m_db.isOpen()) return;
+
+    auto& upsert = m_q_upsert;
+    auto& del    = m_q_delete;
+
+    m_db.transaction();
+    for (auto& key : m_dirty) {
+        if (auto it = m_index.find(key); it != m_index.end()) {
+            auto& e = it->second;
+            upsert.bindValue(":key", convert_from<QString>(key));
+            upsert.bindValue(":content_type", convert_from<QString>(e.item.content_type));
+            upsert.bindValue(":content_length", QVariant::fromValue(e.item.content_length));
+            upsert.bindValue(":timestamp", e.timestamp);
+            if (! upsert.exec()) ERROR_LOG("{}", upsert.lastError().text());
+        } else {
+            del.bindValue(":key", convert_from<QString>(key));
+            if (! del.exec()) ERROR_LOG("{}", del.lastError().text());
+        }
+    }
+    if (! m_db.commit()) {
+        ERROR_LOG("{}", m_db.lastError().text());
+        m_db.rollback();
+    }
+    m_dirty.clear();
+}
+
 void CacheSql::set_limit(i64 limit) {
     asio::dispatch(m_ex, [this, limit]() {
         if (std::exchange(m_limit, limit) != limit) {
@@ -78,33 +286,22 @@ void CacheSql::set_limit(i64 limit) {
 }
 
 void CacheSql::set_clean_cb(clean_cb_t f) { m_clean_cb = std::move(f); }
+void CacheSql::set_insert_cb(insert_cb_t f) { m_insert_cb = std::move(f); }
 
 asio::awaitable<std::optional<CacheSql::Item>> CacheSql::get(std::string key) {
     co_await asio::post(asio::bind_executor(m_ex, asio::use_awaitable));
     try_connect();
 
-    {
-        QSqlQuery q(m_db);
-        q.prepare(QString("SELECT * FROM %1 WHERE key = :key").arg(m_table));
-        q.bindValue(":key", convert_from<QString>(key));
-        if (q.exec()) {
-            while (q.next()) {
-                auto item = query_to_item(q);
-
-                // update timestamp
-                {
-                    QSqlQuery q(m_db);
-                    q.prepare(QString("UPDATE %1 SET timestamp = :timestamp WHERE key = :key;")
-                                  .arg(m_table));
-                    q.bindValue(":key", convert_from<QString>(key));
-                    q.bindValue(":timestamp", QDateTime::currentSecsSinceEpoch());
-                    q.exec();
-                }
-                co_return item;
-            }
-        }
+    if (auto it = m_index.find(key); it != m_index.end()) {
+        auto& e     = it->second;
+        e.timestamp = QDateTime::currentSecsSinceEpoch();
+        lru_unlink(e);
+        lru_push_front(e);
+        mark_dirty(key);
+        m_hits.inc();
+        co_return e.item;
     }
-
+    m_misses.inc();
     co_return std::nullopt;
 }
 
@@ -112,21 +309,18 @@ asio::awaitable<void> CacheSql::insert(Item item) {
     co_await asio::post(asio::bind_executor(m_ex, asio::use_awaitable));
     try_connect();
 
-    {
-        QSqlQuery q(m_db);
-        q.prepare(QString("INSERT OR ABORT INTO %1 (key, content_type, content_length, timestamp) "
-                          "VALUES (:key, "
-                          ":content_type, :content_length, :timestamp);")
-                      .arg(m_table));
-        q.bindValue(":key", convert_from<QString>(item.key));
-        q.bindValue(":content_type", convert_from<QString>(item.content_type));
-        q.bindValue(":content_length", QVariant::fromValue(item.content_length));
-        q.bindValue(":timestamp", QDateTime::currentSecsSinceEpoch());
-        if (q.exec()) {
-            m_total += item.content_length / 1024.0;
-            if (is_reached_limit()) trigger_try_clean();
-        }
-    }
+    // same as "INSERT OR ABORT", keep the existing one
+    if (m_index.contains(item.key)) co_return;
+
+    auto key      = item.key;
+    auto [it, ok] = m_index.try_emplace(
+        key, Entry { .item = std::move(item), .timestamp = QDateTime::currentSecsSinceEpoch() });
+    lru_push_front(it->second);
+    mark_dirty(key);
+    if (m_insert_cb) m_insert_cb(it->second.item);
+
+    m_total += it->second.item.content_length / 1024.0;
+    if (is_reached_limit()) trigger_try_clean();
     co_return;
 }
 
@@ -134,12 +328,17 @@ asio::awaitable<void> CacheSql::remove(std::string key) {
     co_await asio::post(asio::bind_executor(m_ex, asio::use_awaitable));
     try_connect();
 
-    {
-        QSqlQuery q(m_db);
-        q.prepare(QString("DELETE FROM %1 WHERE key = :key").arg(m_table));
-        q.bindValue(":key", convert_from<QString>(key));
-        q.exec();
-    }
+    erase_entry(key);
+    co_return;
+}
+
+asio::awaitable<void> CacheSql::remove(std::vector<std::string> keys) {
+    co_await asio::post(asio::bind_executor(m_ex, asio::use_awaitable));
+    try_connect();
+
+    for (auto& key : keys) erase_entry(key);
+    m_flush_timer.cancel();
+    flush();
     co_return;
 }
 
@@ -147,31 +346,14 @@ asio::awaitable<std::optional<CacheSql::Item>> CacheSql::lru() {
     co_await asio::post(asio::bind_executor(m_ex, asio::use_awaitable));
     try_connect();
 
-    {
-        QSqlQuery q(m_db);
-        q.prepare(QString("SELECT * FROM %1 WHERE timestamp = (SELECT "
-                          "MIN(timestamp) FROM %2)")
-                      .arg(m_table)
-                      .arg(m_table));
-        if (q.exec()) {
-            while (q.next()) {
-                co_return query_to_item(q);
-            }
-        }
-    }
+    if (m_tail) co_return m_tail->item;
     co_return std::nullopt;
 }
 
 usize CacheSql::total_size_sync() {
-    QSqlQuery q(m_db);
-    q.prepare(QString("SELECT SUM(content_length)/1024 FROM %1").arg(m_table));
-    if (q.exec()) {
-        while (q.next()) {
-            auto total = q.value(0).toDouble();
-            return total > 0 ? (usize)total : 0;
-        }
-    }
-    return 0;
+    double total { 0 };
+    for (auto& [_, e] : m_index) total += e.item.content_length / 1024.0;
+    return total > 0 ? (usize)total : 0;
 }
 
 asio::awaitable<usize> CacheSql::total_size() {
@@ -186,14 +368,9 @@ asio::awaitable<std::vector<CacheSql::Item>> CacheSql::get_all() {
     try_connect();
 
     std::vector<CacheSql::Item> out;
-    {
-        QSqlQuery q(m_db);
-        q.prepare(QString("SELECT * FROM %1").arg(m_table));
-        if (q.exec()) {
-            while (q.next()) {
-                out.emplace_back(query_to_item(q));
-            }
-        }
+    out.reserve(m_index.size());
+    for (auto e = m_head; e != nullptr; e = e->next) {
+        out.emplace_back(e->item);
     }
     co_return out;
 }
@@ -202,17 +379,21 @@ asio::awaitable<void> CacheSql::try_clean() {
     co_await asio::post(asio::bind_executor(m_ex, asio::use_awaitable));
     try_connect();
 
-    m_total    = co_await total_size();
-    auto limit = m_limit * 0.9;
-    while (limit > 0 && m_total > limit) {
-        if (auto item = co_await lru(); item) {
-            co_await remove(item->key);
-            m_total -= item->content_length / 1024.0;
-            if (m_clean_cb) m_clean_cb(item->key);
-        } else {
-            break;
-        }
+    // evict from lru tail down to the watermark
+    std::vector<std::string> keys;
+    auto                     limit = m_limit * 0.9;
+    while (limit > 0 && m_total > limit && m_tail) {
+        keys.emplace_back(m_tail->item.key);
+        erase_entry(keys.back());
     }
+    if (keys.empty()) co_return;
+
+    // all deletes in one transaction
+    m_flush_timer.cancel();
+    flush();
+
+    DEBUG_LOG("{} evict {} entries", m_table, keys.size());
+    if (m_clean_cb) m_clean_cb(std::move(keys));
 }
 
 void CacheSql::trigger_try_clean() {
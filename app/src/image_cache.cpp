@@ -0,0 +1,70 @@
+#include "Qcm/image_cache.h"
+
+using namespace qcm;
+
+ImageCache::ImageCache(usize budget): m_budget(budget), m_bytes(0), m_hits(0), m_misses(0) {}
+ImageCache::~ImageCache() {}
+
+QString ImageCache::key(const QString& url, const QSize& size) {
+    return QStringLiteral("%1@%2x%3").arg(url).arg(size.width()).arg(size.height());
+}
+
+std::optional<QImage> ImageCache::get(const QString& key) {
+    std::lock_guard lock { m_mutex };
+    if (auto it = m_map.find(key); it != m_map.end()) {
+        m_hits++;
+        // move to front
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return it->second->image;
+    }
+    m_misses++;
+    return std::nullopt;
+}
+
+bool ImageCache::contains(const QString& key) const {
+    std::lock_guard lock { m_mutex };
+    return m_map.contains(key);
+}
+
+void ImageCache::insert(const QString& key, const QImage& img) {
+    usize size = img.sizeInBytes();
+
+    std::lock_guard lock { m_mutex };
+    if (img.isNull() || size > m_budget) return;
+    if (auto it = m_map.find(key); it != m_map.end()) {
+        m_bytes -= it->second->image.sizeInBytes();
+        m_lru.erase(it->second);
+        m_map.erase(it);
+    }
+    m_lru.push_front(Entry { .key = key, .image = img });
+    m_map.insert({ key, m_lru.begin() });
+    m_bytes += size;
+    evict();
+}
+
+void ImageCache::set_budget(usize v) {
+    std::lock_guard lock { m_mutex };
+    m_budget = v;
+    evict();
+}
+
+void ImageCache::clear() {
+    std::lock_guard lock { m_mutex };
+    m_map.clear();
+    m_lru.clear();
+    m_bytes = 0;
+}
+
+auto ImageCache::stats() const -> Stats {
+    std::lock_guard lock { m_mutex };
+    return { .hits = m_hits, .misses = m_misses, .bytes = m_bytes, .count = m_lru.size() };
+}
+
+void ImageCache::evict() {
+    while (m_bytes > m_budget && ! m_lru.empty()) {
+        auto& back = m_lru.back();
+        m_bytes -= back.image.sizeInBytes();
+        m_map.erase(back.key);
+        m_lru.pop_back();
+    }
+}
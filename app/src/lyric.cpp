@@ -1,8 +1,14 @@
 #include "Qcm/lyric.h"
 
-#include <limits>
+#include <algorithm>
+#include <optional>
+#include <span>
 #include <ctre.hpp>
 
+#include <QPointer>
+#include <asio/post.hpp>
+
+#include "Qcm/app.h"
 #include "Qcm/type.h"
 #include "core/log.h"
 
@@ -13,52 +19,164 @@ namespace
 static constexpr auto RE_LrcLine =
     ctll::fixed_string { "\\[([0-9]{2})[:]([0-9]{2})[.]([0-9]{2,3})\\](.*)" };
 static constexpr auto RE_LrcTagLine = ctll::fixed_string { "\\[([^:]+)[:](.*?)\\]" };
+// [start,duration](start,duration,0)word(start,duration,0)word
+static constexpr auto RE_YrcLine = ctll::fixed_string { "\\[([0-9]+),([0-9]+)\\](.*)" };
+static constexpr auto RE_YrcWord = ctll::fixed_string { "\\(([0-9]+),([0-9]+),[0-9]+\\)" };
+
+void sort_merge(std::vector<LrcLyricLine>& lines) {
+    // lrc is almost sorted, stable keeps the source order of same timestamp
+    std::stable_sort(lines.begin(), lines.end(), [](const auto& a, const auto& b) {
+        return a.milliseconds < b.milliseconds;
+    });
+
+    auto merged = lines.begin();
+    for (auto it = lines.begin(); it != lines.end(); ++it) {
+        if (it == merged) continue;
+        if (it->milliseconds == merged->milliseconds) {
+            merged->content.append('\n').append(it->content);
+        } else if (++merged != it) {
+            *merged = std::move(*it);
+        }
+    }
+    if (! lines.empty()) lines.erase(merged + 1, lines.end());
+}
 
-QList<LrcLyricLine> parse_lrc(const QString& source) {
-    std::map<qlonglong, LrcLyricLine> lrc_map;
-    auto                              list = QStringView(source).split('\n');
+// parse into a flat array sorted by time, duplicate timestamps merged
+std::vector<LrcLyricLine> parse_lrc(const QString& source) {
+    std::vector<LrcLyricLine> out;
+    auto                      list = QStringView(source).split('\n');
 
-    qlonglong last_milli { 0 };
+    std::optional<usize> last_idx;
     for (auto line_ : list) {
         // auto line = convert_from<std::string>(line_.trimmed().toString());
         auto line = line_.trimmed().toUtf8();
 
         if (auto [whole, min, sec, milli, content] = ctre::match<RE_LrcLine>(line); whole) {
-            qlonglong milli_total =
-                (min.to_number() * 60 + sec.to_number()) * 1000 + milli.to_number();
-            auto content_str = helper::trims(content.to_view());
-
-            if (lrc_map.contains(milli_total)) {
-                lrc_map.at(milli_total).content.append('\n').append(QString::fromUtf8(content_str));
-            } else if (! content_str.empty()) {
-                lrc_map.insert({ milli_total,
-                                 LrcLyricLine { .milliseconds = milli_total,
-                                                .content      = QString::fromUtf8(content_str) } });
+            // [mm:ss.xx] is centisecond
+            qlonglong milli_num = milli.to_number() * (milli.to_view().size() == 2 ? 10 : 1);
+            qlonglong milli_total = (min.to_number() * 60 + sec.to_number()) * 1000 + milli_num;
+            auto      content_str = helper::trims(content.to_view());
+
+            last_idx = std::nullopt;
+            if (! content_str.empty()) {
+                last_idx = out.size();
+                out.push_back(LrcLyricLine { .milliseconds = milli_total,
+                                             .content      = QString::fromUtf8(content_str) });
             }
-            last_milli = milli_total;
         } else if (auto [whole, tag, tag_v] = ctre::match<RE_LrcTagLine>(line); whole) {
             // to do
         } else if (! line.isEmpty()) {
             // add this to previous
-            if (lrc_map.contains(last_milli)) {
-                lrc_map.at(last_milli).content.append('\n').append(QString::fromUtf8(line));
+            if (last_idx) {
+                out[last_idx.value()].content.append('\n').append(QString::fromUtf8(line));
             }
         }
     }
-    QList<LrcLyricLine> out;
 
-    std::transform(lrc_map.begin(), lrc_map.end(), std::back_inserter(out), [](auto& el) {
-        return el.second;
-    });
+    sort_merge(out);
+    for (usize i = 0; i + 1 < out.size(); i++) {
+        out[i].duration = out[i + 1].milliseconds - out[i].milliseconds;
+    }
+    return out;
+}
+
+// word timed lyric, json metadata lines are skipped
+std::vector<LrcLyricLine> parse_yrc(const QString& source) {
+    std::vector<LrcLyricLine> out;
+    auto                      list = QStringView(source).split('\n');
+
+    for (auto line_ : list) {
+        auto line = line_.trimmed().toUtf8();
+
+        auto [whole, start, dur, rest] = ctre::match<RE_YrcLine>(line);
+        if (! whole) continue;
+
+        LrcLyricLine l { .milliseconds = start.to_number(), .duration = dur.to_number() };
+
+        auto view = rest.to_view();
+        auto word = ctre::search<RE_YrcWord>(view);
+        while (word) {
+            auto w_start = word.get<1>().to_number();
+            auto w_dur   = word.get<2>().to_number();
+
+            // text runs to the next word tag
+            auto text_begin = word.to_view().data() + word.to_view().size();
+            view = std::string_view { text_begin, view.data() + view.size() };
+            word = ctre::search<RE_YrcWord>(view);
+            auto text_end = word ? word.to_view().data() : view.data() + view.size();
+
+            auto content = QString::fromUtf8(std::string_view { text_begin, text_end });
+            l.content.append(content);
+            l.words.push_back(LrcLyricWord {
+                .milliseconds = w_start, .duration = w_dur, .content = content });
+        }
+        if (! l.content.trimmed().isEmpty()) out.push_back(std::move(l));
+    }
 
+    std::stable_sort(out.begin(), out.end(), [](const auto& a, const auto& b) {
+        return a.milliseconds < b.milliseconds;
+    });
     return out;
 }
 
+// put each line of a secondary track on the nearest base line
+void attach(std::vector<LrcLyricLine>& base, std::span<const qlonglong> times,
+            const QString& source, QString LrcLyricLine::*field) {
+    if (base.empty()) return;
+    for (auto& el : parse_lrc(source)) {
+        auto t  = el.milliseconds;
+        auto it = std::lower_bound(times.begin(), times.end(), t);
+        if (it == times.end() || (it != times.begin() && t - *(it - 1) < *it - t)) --it;
+
+        auto& target = base[std::distance(times.begin(), it)].*field;
+        if (! target.isEmpty()) target.append('\n');
+        target.append(el.content);
+    }
+}
+
+std::vector<qlonglong> line_times(const std::vector<LrcLyricLine>& lines) {
+    std::vector<qlonglong> times;
+    times.reserve(lines.size());
+    std::transform(lines.begin(), lines.end(), std::back_inserter(times), [](auto& el) {
+        return el.milliseconds;
+    });
+    return times;
+}
+
+// merge all tracks into one timeline, word timed source is preferred as base
+std::vector<LrcLyricLine> build_timeline(const LrcLyric::Sources& sources) {
+    auto lines = parse_yrc(sources.yrc);
+    if (lines.empty()) lines = parse_lrc(sources.lrc);
+
+    auto times = line_times(lines);
+    attach(lines, times, sources.trans, &LrcLyricLine::translation);
+    attach(lines, times, sources.roma, &LrcLyricLine::romanization);
+    return lines;
+}
+
+qreal span_progress(qlonglong start, qlonglong duration, qlonglong pos) {
+    if (pos < start) return 0;
+    if (duration <= 0) return 1;
+    return std::clamp((qreal)(pos - start) / duration, 0.0, 1.0);
+}
+
+// index of the last line with time <= pos, -1 if before the first line
+qlonglong find_index(std::span<const qlonglong> times, qlonglong pos) {
+    auto it = std::upper_bound(times.begin(), times.end(), pos);
+    return std::distance(times.begin(), it) - 1;
+}
+
 } // namespace
 
 LrcLyric::LrcLyric(QObject* parent)
-    : meta_model::QGadgetListModel<LrcLyricLine>(parent), m_cur_idx(-1), m_position(0) {
-    connect(this, &LrcLyric::sourceChanged, this, &LrcLyric::parseLrc);
+    : meta_model::QGadgetListModel<LrcLyricLine>(parent),
+      m_cur_idx(-1),
+      m_cur_word(-1),
+      m_position(0),
+      m_progress(0),
+      m_word_progress(0),
+      m_parse_id(0),
+      m_parse_pending(false) {
     connect(this, &LrcLyric::positionChanged, this, &LrcLyric::refreshIndex);
 }
 LrcLyric::~LrcLyric() {}
@@ -71,6 +189,9 @@ void      LrcLyric::setPosition(qlonglong v) {
 }
 
 qlonglong LrcLyric::currentIndex() const { return m_cur_idx; }
+qlonglong LrcLyric::currentWordIndex() const { return m_cur_word; }
+qreal     LrcLyric::progress() const { return m_progress; }
+qreal     LrcLyric::wordProgress() const { return m_word_progress; }
 
 void LrcLyric::setCurrentIndex(qlonglong v) {
     if (std::exchange(m_cur_idx, v) != v) {
@@ -78,52 +199,102 @@ void LrcLyric::setCurrentIndex(qlonglong v) {
     }
 }
 
-QString LrcLyric::source() const { return m_source; }
-void    LrcLyric::setSource(QString v) {
-    if (std::exchange(m_source, v) != v) {
-        setCurrentIndex(-1);
-        emit sourceChanged();
+QString LrcLyric::source() const { return m_sources.lrc; }
+void    LrcLyric::setSource(QString v) { set_source(&Sources::lrc, v); }
+QString LrcLyric::translation() const { return m_sources.trans; }
+void    LrcLyric::setTranslation(QString v) { set_source(&Sources::trans, v); }
+QString LrcLyric::romanization() const { return m_sources.roma; }
+void    LrcLyric::setRomanization(QString v) { set_source(&Sources::roma, v); }
+QString LrcLyric::wordSource() const { return m_sources.yrc; }
+void    LrcLyric::setWordSource(QString v) { set_source(&Sources::yrc, v); }
+
+void LrcLyric::set_source(QString Sources::*field, QString v) {
+    if (std::exchange(m_sources.*field, v) == v) return;
+    setCurrentIndex(-1);
+    emit sourceChanged();
+
+    // tracks usually change together, parse once for all
+    if (! std::exchange(m_parse_pending, true)) {
+        QMetaObject::invokeMethod(this, &LrcLyric::parseLrc, Qt::QueuedConnection);
     }
 }
 
 void LrcLyric::parseLrc() {
-    resetModel(parse_lrc(m_source));
+    m_parse_pending = false;
+
+    auto                  id = ++m_parse_id;
+    QPointer<LrcLyric>    self { this };
+    asio::any_io_executor main_ex { App::instance()->get_executor() };
+    asio::post(App::instance()->get_pool_executor(), [self, main_ex, id, sources = m_sources]() {
+        auto lines = build_timeline(sources);
+        asio::post(main_ex, [self, id, lines = std::move(lines)]() mutable {
+            if (self && self->m_parse_id == id) self->apply_lines(std::move(lines));
+        });
+    });
+}
+
+void LrcLyric::apply_lines(std::vector<LrcLyricLine>&& lines) {
+    m_times = line_times(lines);
+    resetModel(lines);
+    m_cur_idx  = -1;
+    m_cur_word = -1;
     refreshIndex();
 }
 
 void LrcLyric::refreshIndex() {
-    auto old   = m_cur_idx;
-    auto begin = this->begin();
-    auto end   = this->end();
-
-    if (begin < end) {
-        auto it = begin + m_cur_idx;
-
-        auto pos = m_position < 0 ? 0 : m_position;
-
-        auto milli = [begin, end](auto it) -> qlonglong {
-            if (it < begin)
-                return -1;
-            else if (it >= end)
-                return std::numeric_limits<qlonglong>::max();
-            else
-                return it->milliseconds;
-        };
-
-        // check left
-        while (milli(it) > pos) {
-            it--;
-        }
+    auto old = m_cur_idx;
+    auto pos = m_position < 0 ? 0 : m_position;
+    auto cur = [this](qlonglong idx, qlonglong pos) -> bool {
+        auto size = (qlonglong)m_times.size();
+        if (idx < -1 || idx >= size) return false;
+        return (idx < 0 || m_times[idx] <= pos) && (idx + 1 >= size || m_times[idx + 1] > pos);
+    };
 
-        // check right
-        while (milli(it + 1) <= pos) {
-            it++;
-        }
-        m_cur_idx = std::distance(begin, it);
-    } else
+    if (m_times.empty()) {
         m_cur_idx = -1;
+    } else if (cur(m_cur_idx, pos)) {
+        // still in current line
+    } else if (cur(m_cur_idx + 1, pos)) {
+        // monotonic playback, step to next line
+        m_cur_idx = m_cur_idx + 1;
+    } else {
+        // seek
+        m_cur_idx = find_index(m_times, pos);
+    }
 
     if (old != m_cur_idx) {
         emit currentIndexChanged();
     }
+    refresh_word(pos);
+}
+
+void LrcLyric::refresh_word(qlonglong pos) {
+    auto old_word     = m_cur_word;
+    auto old_progress = std::pair { m_progress, m_word_progress };
+
+    m_cur_word      = -1;
+    m_progress      = 0;
+    m_word_progress = 0;
+    if (m_cur_idx >= 0 && (usize)m_cur_idx < size()) {
+        auto& line = at(m_cur_idx);
+        m_progress = span_progress(line.milliseconds, line.duration, pos);
+
+        auto& words = line.words;
+        auto  it    = std::upper_bound(
+            words.begin(), words.end(), pos, [](qlonglong pos, const LrcLyricWord& w) {
+                return pos < w.milliseconds;
+            });
+        if (it != words.begin()) {
+            --it;
+            m_cur_word      = std::distance(words.begin(), it);
+            m_word_progress = span_progress(it->milliseconds, it->duration, pos);
+        }
+    }
+
+    if (old_word != m_cur_word) {
+        emit currentWordIndexChanged();
+    }
+    if (old_progress != std::pair { m_progress, m_word_progress }) {
+        emit progressChanged();
+    }
 }
@@ -3,14 +3,21 @@
 #include <filesystem>
 #include <cstdio>
 #include <fstream>
+#include <array>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <unordered_map>
 
 #include <ctre.hpp>
 #include <QtCore/QPointer>
+#include <QImageReader>
 
 #include "Qcm/app.h"
 #include "Qcm/type.h"
 #include "Qcm/path.h"
 #include "Qcm/cache_sql.h"
+#include "Qcm/image_cache.h"
 
 #include "core/expected_helper.h"
 #include "request/response.h"
@@ -36,6 +43,45 @@ inline QSize get_down_size(const QSize& req) {
     return req;
 }
 
+// square sizes are served from a pyramid derived from one master image
+constexpr std::array PYRAMID_LEVELS { 300, 400, 800, 1200 };
+constexpr int        PYRAMID_MASTER { PYRAMID_LEVELS.back() };
+
+// 0 for not in pyramid
+inline int pyramid_level(const QSize& req) {
+    if (! req.isValid()) return 0;
+    auto down = get_down_size(req);
+    if (down.width() != down.height()) return 0;
+    auto it = std::lower_bound(PYRAMID_LEVELS.begin(), PYRAMID_LEVELS.end(), down.width());
+    return it != PYRAMID_LEVELS.end() ? *it : 0;
+}
+
+// the size a cache file is fetched at, all requests sharing the file decode to it
+inline QSize bucket_size(const QSize& req) {
+    if (auto level = pyramid_level(req)) return { level, level };
+    return req.isValid() ? get_down_size(req) : req;
+}
+
+// decode scaled down to the bucket, in the format the scene graph uploads
+QImage decode_image(const std::filesystem::path& path, const QSize& req) {
+    QImageReader reader(QString::fromStdString(path.native()));
+    reader.setAutoTransform(true);
+
+    auto bucket = bucket_size(req);
+    auto size   = reader.size();
+    if (bucket.isValid() && size.isValid() &&
+        (size.width() > bucket.width() || size.height() > bucket.height())) {
+        reader.setScaledSize(size.scaled(bucket, Qt::AspectRatioMode::KeepAspectRatio));
+    }
+
+    auto img = reader.read();
+    if (img.isNull()) {
+        WARN_LOG("decode {} failed: {}", path.native(), reader.errorString().toStdString());
+        return img;
+    }
+    return img.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+}
+
 inline std::string gen_file_name(const request::URI& url) {
     return UNWRAP(
         crypto::digest(crypto::md5(),
@@ -54,35 +100,124 @@ void header_record_db(const request::Header& h, CacheSql::Item& db_it) {
     }
 }
 
+// bounded concurrent downloads per host, queued fifo
+class HostLimiter : NoCopy {
+public:
+    HostLimiter(usize limit): m_limit(limit) {}
+
+    // slot is released when the returned guard is dropped
+    asio::awaitable<rc<void>> acquire(std::string host) {
+        auto waiter = std::make_shared<Waiter>(co_await asio::this_coro::executor);
+        {
+            std::lock_guard lock { m_mutex };
+            auto&           st = m_hosts[host];
+            if (st.active < m_limit) {
+                st.active++;
+                waiter->granted = true;
+            } else {
+                waiter->timer.expires_at(asio::steady_timer::time_point::max());
+                st.queue.push_back(waiter);
+            }
+        }
+        if (waiter->granted) co_return guard(host);
+
+        co_await waiter->timer.async_wait(asio::as_tuple(asio::use_awaitable));
+        {
+            std::lock_guard lock { m_mutex };
+            if (! waiter->granted) {
+                // cancelled while queued
+                std::erase(m_hosts[host].queue, waiter);
+                throw std::system_error(asio::error::operation_aborted);
+            }
+        }
+        co_return guard(host);
+    }
+
+private:
+    struct Waiter {
+        Waiter(asio::any_io_executor ex): timer(ex) {}
+        asio::steady_timer timer;
+        bool               granted { false };
+    };
+    struct State {
+        usize                  active { 0 };
+        std::deque<rc<Waiter>> queue;
+    };
+
+    rc<void> guard(const std::string& host) {
+        return rc<void>(this, [host](HostLimiter* self) {
+            self->release(host);
+        });
+    }
+
+    void release(const std::string& host) {
+        std::lock_guard lock { m_mutex };
+        auto&           st = m_hosts[host];
+        if (! st.queue.empty()) {
+            // hand the slot over
+            auto w = st.queue.front();
+            st.queue.pop_front();
+            w->granted = true;
+            asio::post(w->timer.get_executor(), [w]() {
+                w->timer.cancel();
+            });
+        } else if (--st.active == 0) {
+            m_hosts.erase(host);
+        }
+    }
+
+    usize                                  m_limit;
+    std::mutex                             m_mutex;
+    std::unordered_map<std::string, State> m_hosts;
+};
+
+constexpr usize MAX_DL_PER_HOST { 6 };
+
 } // namespace
 
 namespace qcm
 {
 
 NcmAsyncImageResponse::NcmAsyncImageResponse() {}
-NcmAsyncImageResponse::~NcmAsyncImageResponse() { plt::malloc_trim_count(0, 10); }
+NcmAsyncImageResponse::~NcmAsyncImageResponse() {
+    if (m_cancel_cb) m_cancel_cb();
+    plt::malloc_trim_count(0, 10);
+}
+
+void NcmAsyncImageResponse::set_cancel_cb(std::function<void()> cb) { m_cancel_cb = std::move(cb); }
+
+void NcmAsyncImageResponse::cancel() {
+    m_wdog.cancel();
+    if (auto cb = std::exchange(m_cancel_cb, {})) cb();
+    emit finished();
+}
 
 QQuickTextureFactory* NcmAsyncImageResponse::textureFactory() const {
     return QQuickTextureFactory::textureFactoryForImage(m_image);
 }
 
-class NcmImageProviderInner : std::enable_shared_from_this<NcmImageProviderInner>, NoCopy {
+class NcmImageProviderInner : public std::enable_shared_from_this<NcmImageProviderInner>,
+                              NoCopy {
 public:
     using executor_type = asio::thread_pool::executor_type;
 
     executor_type& get_executor() { return m_ex; }
     auto&          get_client() { return m_cli; }
+    auto&          get_image_cache() { return m_image_cache; }
 
     NcmImageProviderInner()
         : m_ex(App::instance()->get_pool_executor()),
           m_cli(App::instance()->ncm_client()),
-          m_cache_sql(App::instance()->get_cache_sql()) {}
+          m_cache_sql(App::instance()->get_cache_sql()),
+          m_image_cache(App::instance()->get_image_cache()),
+          m_host_limiter(MAX_DL_PER_HOST) {}
 
     asio::awaitable<request::Header> dl_image(const request::Request& req,
                                               std::filesystem::path   p) {
         helper::SyncFile file { std::fstream(p, std::ios::out | std::ios::binary) };
         file.handle().exceptions(std::ios_base::failbit | std::ios_base::badbit);
 
+        auto slot     = co_await m_host_limiter.acquire(std::string(req.url_info().host));
         auto rsp_http = co_await m_cli.rsp(req);
         co_await rsp_http->read_to_stream(file);
 
@@ -98,10 +233,18 @@ public:
         auto file_dl = cache_file;
         file_dl.replace_extension(fmt::format("dl{}x{}", req_size.width(), req_size.height()));
 
-        auto header = co_await dl_image(req, file_dl);
+        request::Header header;
+        try {
+            header = co_await dl_image(req, file_dl);
+        } catch (...) {
+            std::error_code ec;
+            std::filesystem::remove(file_dl, ec);
+            throw;
+        }
         std::filesystem::rename(file_dl, cache_file);
         header_record_db(header, db_it);
-        co_await m_cache_sql->insert(db_it);
+        // the file is complete, index it even if the flight is cancelled now
+        asio::co_spawn(m_cache_sql->get_executor(), m_cache_sql->insert(db_it), asio::detached);
     }
 
     asio::awaitable<QImage> request_image(const request::Request& req,
@@ -111,20 +254,117 @@ public:
         if (! std::filesystem::exists(cache_path)) {
             co_await cache_new_image(req, key, cache_path, req_size);
         }
-        auto img = QImage(cache_path.c_str());
-        // do not scale twice
-        //if (req_size.isValid()) {
-        //    img = img.scaled(req_size, Qt::AspectRatioMode::KeepAspectRatio);
-        //}
+        auto img = decode_image(cache_path, req_size);
+        if (img.isNull()) {
+            // broken download, drop the file and its row so the next request fetches again
+            std::error_code ec;
+            std::filesystem::remove(cache_path, ec);
+            asio::co_spawn(m_cache_sql->get_executor(), m_cache_sql->remove(key), asio::detached);
+        }
         co_return img;
     }
 
-    asio::awaitable<void> handle_request(QPointer<NcmAsyncImageResponse> rsp_guard,
-                                         request::Request req, std::filesystem::path cache_path,
-                                         QSize req_size) {
-        auto img = co_await request_image(req, cache_path, req_size);
-        NcmImageProviderInner::handle_res(rsp_guard, img);
-        co_return;
+    struct Waiter {
+        QPointer<NcmAsyncImageResponse> rsp;
+        QString                         mem_key;
+        // identity for leave, null for prefetch
+        const void*                     owner { nullptr };
+        // pyramid level to derive from the flight image, 0 for as is
+        int                   level { 0 };
+        std::filesystem::path level_path {};
+    };
+
+    // high quality downscale, stored beside the master in the master's file format
+    QImage derive_level(const QImage& master, const std::filesystem::path& master_path, int level,
+                        const std::filesystem::path& path) {
+        if (master.isNull() || std::max(master.width(), master.height()) <= level) return master;
+
+        auto img = master.scaled(
+            level, level, Qt::AspectRatioMode::KeepAspectRatio, Qt::SmoothTransformation);
+
+        auto file_tmp = path;
+        file_tmp.replace_extension(fmt::format("lv{}", level));
+        // decoded images are always rgba, so ask the file instead
+        auto src  = QImageReader::imageFormat(QString::fromStdString(master_path.native()));
+        bool jpeg = src == "jpeg" || src == "jpg";
+        if (img.save(QString::fromStdString(file_tmp.native()), jpeg ? "JPG" : "PNG", 90)) {
+            std::error_code ec;
+            std::filesystem::rename(file_tmp, path, ec);
+            if (! ec) {
+                CacheSql::Item db_it;
+                db_it.key            = path.filename().native();
+                db_it.content_type   = jpeg ? "image/jpeg" : "image/png";
+                db_it.content_length = std::filesystem::file_size(path, ec);
+                asio::co_spawn(
+                    m_cache_sql->get_executor(), m_cache_sql->insert(db_it), asio::detached);
+            } else {
+                ERROR_LOG("{}", ec.message());
+            }
+        } else {
+            WARN_LOG("save image level failed: {}", file_tmp.native());
+        }
+        return img;
+    }
+
+    // one download and decode per cache path, shared by all waiters
+    void join(const request::Request& req, const std::filesystem::path& cache_path,
+              QSize req_size, Waiter waiter, const QString& id) {
+        auto key    = cache_path.native();
+        auto flight = std::make_shared<Flight>(asio::make_strand(m_ex));
+        {
+            std::lock_guard lock { m_flight_mutex };
+            auto [it, inserted] = m_flights.try_emplace(key, flight);
+            // joined before a posted cancel ran, keep the flight going
+            it->second->cancelling = false;
+            it->second->waiters.push_back(std::move(waiter));
+            if (! inserted) return;
+        }
+        start(flight, key, req, cache_path, req_size, id);
+    }
+
+    // waiter gone, cancel the flight if nobody else wants it
+    void leave(const std::string& key, const void* owner) {
+        std::lock_guard lock { m_flight_mutex };
+        auto            it = m_flights.find(key);
+        if (it == m_flights.end()) return;
+
+        auto flight = it->second;
+        if (std::erase_if(flight->waiters, [owner](auto& w) {
+                return w.owner == owner;
+            }) == 0)
+            return;
+        if (flight->waiters.empty()) {
+            // stays in the map until it completes, so the same path never has two downloads
+            flight->cancelling = true;
+            asio::post(flight->ex, [self = shared_from_this(), flight]() {
+                std::lock_guard lock { self->m_flight_mutex };
+                if (! flight->cancelling) return;
+                flight->cancelling = false;
+                flight->aborted    = true;
+                flight->wdog.cancel();
+            });
+        }
+    }
+
+    // start or join the flight for this request, return the flight key
+    std::string fetch(const QString& id, const QSize& size, Waiter waiter) {
+        request::Request      req       = NcmImageProvider::makeReq(id, size, m_cli);
+        std::filesystem::path file_path = NcmImageProvider::genImageCachePath(req);
+
+        auto level = pyramid_level(size);
+        if (level == 0 || level == PYRAMID_MASTER || std::filesystem::exists(file_path)) {
+            join(req, file_path, size, std::move(waiter), id);
+            return file_path.native();
+        }
+
+        // fetch or reuse the master, then derive this level from it
+        auto master_size = QSize(PYRAMID_MASTER, PYRAMID_MASTER);
+        auto master_req  = NcmImageProvider::makeReq(id, master_size, m_cli);
+        auto master_path = NcmImageProvider::genImageCachePath(master_req);
+        waiter.level      = level;
+        waiter.level_path = file_path;
+        join(master_req, master_path, master_size, std::move(waiter), id);
+        return master_path.native();
     }
 
     static void handle_res(QPointer<NcmAsyncImageResponse> rsp_guard,
@@ -139,16 +379,94 @@ public:
     };
 
 private:
-    executor_type m_ex;
-    ncm::Client   m_cli;
-    rc<CacheSql>  m_cache_sql;
+    struct Flight {
+        Flight(asio::strand<executor_type> ex): ex(ex) {}
+        asio::strand<executor_type> ex;
+        helper::WatchDog            wdog;
+        std::vector<Waiter>         waiters;
+        QImage                      image;
+        // guarded by m_flight_mutex
+        // cancel posted after the last waiter left, cleared by a join before it runs
+        bool                        cancelling { false };
+        // cancelled, waiters that joined since need a restart
+        bool                        aborted { false };
+    };
+
+    void start(rc<Flight> flight, const std::string& key, const request::Request& req,
+               const std::filesystem::path& cache_path, QSize req_size, const QString& id) {
+        auto& ex = flight->ex;
+        asio::co_spawn(
+            ex,
+            flight->wdog.watch(ex,
+                               [self = shared_from_this(), flight, req, cache_path, req_size]()
+                                   -> asio::awaitable<void> {
+                                   flight->image =
+                                       co_await self->request_image(req, cache_path, req_size);
+                               }),
+            [self = shared_from_this(), flight, key, req, cache_path, req_size, id](
+                std::exception_ptr p) {
+                std::vector<Waiter> waiters;
+                bool                restart { false };
+                {
+                    std::lock_guard lock { self->m_flight_mutex };
+                    if (flight->aborted && ! flight->waiters.empty()) {
+                        // joined after the cancel ran, download again for them
+                        flight->aborted = false;
+                        restart         = true;
+                    } else {
+                        self->m_flights.erase(key);
+                        waiters = std::move(flight->waiters);
+                    }
+                }
+                if (restart) {
+                    self->start(flight, key, req, cache_path, req_size, id);
+                    return;
+                }
+
+                nstd::expected<QImage, QString> res { flight->image };
+                std::map<int, QImage>           levels;
+                // the file is only dropped on a broken download, see request_image
+                if (p) {
+                    try {
+                        std::rethrow_exception(p);
+                    } catch (const std::exception& e) {
+                        res = nstd::unexpected(convert_from<QString>(
+                            fmt::format("NcmImageProvider, id: {}, error: {}", id, e.what())));
+                    }
+                }
+                for (auto& w : waiters) {
+                    if (res && w.level > 0) {
+                        auto& img = levels[w.level];
+                        if (img.isNull())
+                            img = self->derive_level(
+                                res.value(), cache_path, w.level, w.level_path);
+                        self->m_image_cache->insert(w.mem_key, img);
+                        if (w.rsp) NcmImageProviderInner::handle_res(w.rsp, img);
+                        continue;
+                    }
+                    if (res) self->m_image_cache->insert(w.mem_key, res.value());
+                    if (w.rsp) NcmImageProviderInner::handle_res(w.rsp, res);
+                }
+            });
+    }
+
+    executor_type  m_ex;
+    ncm::Client    m_cli;
+    rc<CacheSql>   m_cache_sql;
+    rc<ImageCache> m_image_cache;
+    HostLimiter    m_host_limiter;
+
+    std::mutex                                  m_flight_mutex;
+    std::unordered_map<std::string, rc<Flight>> m_flights;
 };
 } // namespace qcm
 
 request::Request NcmImageProvider::makeReq(const QString& id, const QSize& requestedSize,
                                            ncm::Client& cli) {
     request::UrlParams query;
-    if (requestedSize.isValid()) {
+    if (auto level = pyramid_level(requestedSize)) {
+        query.set_param("param", fmt::format("{}y{}", level, level));
+    } else if (requestedSize.isValid()) {
         auto down_size = get_down_size(requestedSize);
         query.set_param("param", fmt::format("{}y{}", down_size.width(), down_size.height()));
     }
@@ -174,34 +492,22 @@ QQuickImageResponse* NcmImageProvider::requestImageResponse(const QString& id,
         return rsp;
     }
 
-    auto ex = asio::make_strand(m_inner->get_executor());
-
-    auto                  rsp_guard = QPointer(rsp);
-    request::Request      req = NcmImageProvider::makeReq(id, requestedSize, m_inner->get_client());
-    std::filesystem::path file_path = NcmImageProvider::genImageCachePath(req);
+    auto mem_key = ImageCache::key(id, requestedSize);
+    if (auto img = m_inner->get_image_cache()->get(mem_key)) {
+        rsp->handle(std::move(img).value());
+        return rsp;
+    }
 
-    asio::co_spawn(
-        ex,
-        rsp->wdog().watch(
-            ex,
-            [rsp_guard, requestedSize, req, file_path, inner = m_inner]() -> asio::awaitable<void> {
-                co_await inner->handle_request(rsp_guard, req, file_path, requestedSize);
-                co_return;
-            }),
-        [rsp_guard, file_path, id](std::exception_ptr p) {
-            if (p) {
-                try {
-                    if (std::filesystem::exists(file_path)) {
-                        std::filesystem::remove(file_path);
-                    }
-                    std::rethrow_exception(p);
-                } catch (const std::exception& e) {
-                    NcmImageProviderInner::handle_res(
-                        rsp_guard,
-                        nstd::unexpected(convert_from<QString>(
-                            fmt::format("NcmImageProvider, id: {}, error: {}", id, e.what()))));
-                }
-            }
-        });
+    auto key = m_inner->fetch(id, requestedSize, { QPointer(rsp), mem_key, rsp });
+    rsp->set_cancel_cb([inner = std::weak_ptr(m_inner), key, owner = (const void*)rsp]() {
+        if (auto self = inner.lock()) self->leave(key, owner);
+    });
     return rsp;
-}
\ No newline at end of file
+}
+
+void NcmImageProvider::prefetch(const QString& id, const QSize& requestedSize) {
+    if (id.isEmpty()) return;
+    auto mem_key = ImageCache::key(id, requestedSize);
+    if (m_inner->get_image_cache()->contains(mem_key)) return;
+    m_inner->fetch(id, requestedSize, { nullptr, mem_key });
+}
@@ -93,11 +93,35 @@ void        Player::set_source(const QUrl& v) {
 int                   Player::position() const { return m_position; }
 int                   Player::duration() const { return m_duration; }
 Player::PlaybackState Player::playbackState() const { return m_playback_state; }
+float                 Player::volume() const { return m_player->volume(); }
+void                  Player::set_volume(float v) {
+    if (m_player->volume() != v) {
+        m_player->set_volume(v);
+        emit volumeChanged();
+    }
+}
 
 void Player::play() { m_player->play(); }
 void Player::pause() { m_player->pause(); }
 void Player::stop() { m_player->stop(); }
 
+QVariantMap Player::deviceStats() const {
+    auto s = m_player->stats();
+    return QVariantMap {
+        { "callbacks", (qulonglong)s.callbacks },
+        { "underruns", (qulonglong)s.underruns },
+        { "decodeUnderruns", (qulonglong)s.decode_underruns },
+        { "inputUnderruns", (qulonglong)s.input_underruns },
+        { "lateCallbacks", (qulonglong)s.late_callbacks },
+        { "silentFrames", (qulonglong)s.silent_frames },
+        { "callbackUsP50", (qulonglong)s.cb_time_p50 },
+        { "callbackUsP99", (qulonglong)s.cb_time_p99 },
+        { "callbackUsMax", (qulonglong)s.cb_time_max },
+        { "queueFillP1", (qulonglong)s.queue_fill_p1 },
+        { "queueFillP50", (qulonglong)s.queue_fill_p50 },
+    };
+}
+
 void Player::set_position(int v) {
     if (m_duration > 0) {
         m_player->seek(v + 50);
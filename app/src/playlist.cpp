@@ -1,15 +1,73 @@
 #include "Qcm/playlist.h"
 
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFile>
+#include <QPointer>
+
+#include <asio/post.hpp>
+#include <asio/strand.hpp>
+
+#include "Qcm/app.h"
+#include "Qcm/path.h"
 #include "core/random.h"
+#include <algorithm>
 #include <ranges>
+#include <unordered_map>
 
 using namespace qcm;
 
 namespace
 {
 
+// magic, version, cursor(cur index, position), songs, shuffle order
+constexpr quint32 SnapshotMagic { 0x51434d51 };
+constexpr quint32 SnapshotVersion { 1 };
+// cursor is at a fixed offset, rewrite it in place
+constexpr qint64 SnapshotCursorOffset { 8 };
+constexpr qint64 SnapshotCursorSize { 12 };
+
+constexpr int SnapshotDelay { 1000 };
+constexpr int CursorDelay { 5000 };
+
 const QString& sid(const model::Song& s) { return s.id.id; }
 
+QString snapshot_path() {
+    return convert_from<QString>((data_path() / "play_queue.bin").native());
+}
+
+void write_song(QDataStream& s, const model::Song& song) {
+    s << song.id.id << song.name << song.album.id.id << song.album.name << song.album.picUrl
+      << song.duration.toMSecsSinceEpoch() << song.canPlay << song.coverUrl << song.tags;
+    s << (quint32)song.artists.size();
+    for (auto& ar : song.artists) s << ar.id.id << ar.name;
+}
+
+model::Song read_song(QDataStream& s) {
+    model::Song song;
+    qint64      duration { 0 };
+    quint32     ar_size { 0 };
+    s >> song.id.id >> song.name >> song.album.id.id >> song.album.name >> song.album.picUrl >>
+        duration >> song.canPlay >> song.coverUrl >> song.tags;
+    song.duration = QDateTime::fromMSecsSinceEpoch(duration);
+
+    s >> ar_size;
+    for (quint32 i = 0; i < ar_size && s.status() == QDataStream::Ok; i++) {
+        model::Artist ar;
+        s >> ar.id.id >> ar.name;
+        song.artists << ar;
+    }
+    return song;
+}
+
+QByteArray serialize_cursor(qint32 cur, qint64 position) {
+    QByteArray  buf;
+    QDataStream s(&buf, QIODevice::WriteOnly);
+    s.setVersion(QDataStream::Qt_6_0);
+    s << cur << position;
+    return buf;
+}
+
 } // namespace
 
 namespace qcm::detail
@@ -17,9 +75,12 @@ namespace qcm::detail
 class PlayList {
 public:
     using list_type      = std::vector<QString>;
+    using index_type     = std::unordered_map<QString, usize>;
     using iterator       = list_type::iterator;
     using const_iterator = list_type::const_iterator;
 
+    PlayList(): m_dirty_from(0) {}
+
     auto begin() const { return m_list.begin(); }
     auto end() const { return m_list.end(); }
     auto size() const { return m_list.size(); }
@@ -27,19 +88,21 @@ public:
     auto begin() { return m_list.begin(); }
     auto end() { return m_list.end(); }
     auto pos_it(const QString& s) const {
-        return std::find_if(begin(), end(), [&s](auto& s_) {
-            return s == s_;
-        });
+        auto p = pos(s);
+        return p ? begin() + p.value() : end();
     }
     auto pos_it(const QString& s) {
-        return std::find_if(begin(), end(), [&s](auto& s_) {
-            return s == s_;
-        });
+        auto p = pos(s);
+        return p ? begin() + p.value() : end();
     }
     std::optional<usize> pos(const QString& s) const {
-        auto it = pos_it(s);
-        return it == end() ? std::nullopt : std::make_optional((usize)std::distance(begin(), it));
+        auto it = m_index.find(s);
+        if (it == m_index.end()) return std::nullopt;
+        // positions before m_dirty_from are always valid
+        if (it->second >= m_dirty_from) renumber();
+        return it->second;
     }
+    bool contains(const QString& s) const { return m_index.contains(s); }
 
     bool                   cur_ok() const { return (bool)m_cur_pos; }
     auto                   cur_it() const { return cur_ok() ? begin() + m_cur_pos.value() : end(); }
@@ -59,13 +122,10 @@ public:
                 m_cur_pos = std::nullopt;
         }
 
+        m_index.erase(*it);
+        mark_dirty(d);
         return m_list.erase(it);
     }
-    auto insert(const_iterator it, const QString& s) {
-        auto* p    = &s;
-        auto* pend = p + 1;
-        return m_list.insert(it, p, pend);
-    }
     template<typename Tin>
     auto insert(const_iterator it, Tin&& beg, Tin&& end) {
         const auto& self = *this;
@@ -75,12 +135,23 @@ public:
         auto out      = m_list.insert(it, beg, end);
         auto in_size  = size() - old_size;
 
+        for (usize i = d; i < d + in_size; i++) {
+            m_index.insert_or_assign(m_list[i], i);
+        }
+        // the shifted tail still holds indices from d on
+        mark_dirty(d);
+
         if (m_cur_pos) {
             auto p = m_cur_pos.value();
             if (d <= p) m_cur_pos = p + in_size;
         }
         return out;
     }
+    auto insert(const_iterator it, const QString& s) {
+        auto* p    = &s;
+        auto* pend = p + 1;
+        return insert(it, p, pend);
+    }
     auto move(iterator from, iterator to) {
         if (m_cur_pos) {
             auto p = begin() + m_cur_pos.value();
@@ -89,11 +160,14 @@ public:
             else if (p == from)
                 m_cur_pos = (usize)std::distance(begin(), to);
         }
+        mark_dirty((usize)std::distance(begin(), std::min(from, to)));
         return std::rotate(from, from + 1, to);
     }
     void clear() {
         m_cur_pos = std::nullopt;
         m_list.clear();
+        m_index.clear();
+        m_dirty_from = 0;
     }
 
     void erase(const QString& s) {
@@ -103,8 +177,7 @@ public:
     const auto& at(usize p) const { return m_list.at(p); }
 
     void set_cur(const QString& s) {
-        auto it = pos_it(s);
-        if (it != end()) m_cur_pos = (usize)std::distance(begin(), it);
+        if (auto p = pos(s)) m_cur_pos = p;
     }
 
     void try_set_cur_frist() {
@@ -152,7 +225,19 @@ public:
     }
 
 private:
-    std::vector<QString> m_list;
+    void mark_dirty(usize from) { m_dirty_from = std::min(m_dirty_from, from); }
+
+    // lazy renumber, only touch the stale tail
+    void renumber() const {
+        for (auto i = m_dirty_from; i < m_list.size(); i++) {
+            m_index.find(m_list[i])->second = i;
+        }
+        m_dirty_from = m_list.size();
+    }
+
+    list_type            m_list;
+    mutable index_type   m_index;
+    mutable usize        m_dirty_from;
     std::optional<usize> m_cur_pos;
 };
 
@@ -178,8 +263,87 @@ struct qcm::Playlist::CurGuard {
     std::optional<usize>   cur_pos;
 };
 
+struct qcm::Playlist::Batch {
+    enum class Oper
+    {
+        Append,
+        AppendNext,
+        Remove,
+        Clear,
+    };
+    struct Item {
+        Oper        oper;
+        model::Song song;
+    };
+
+    void append(const std::vector<model::Song>& songs) {
+        for (auto& s : songs) items.push_back({ Oper::Append, s });
+    }
+
+    bool append_only() const {
+        return std::ranges::all_of(items, [](const Item& it) {
+            return it.oper == Oper::Append;
+        });
+    }
+
+    std::vector<Item> items;
+};
+
+struct qcm::Playlist::Snapshot {
+    static std::optional<Snapshot> load(const QString& path) {
+        QFile file(path);
+        if (! file.open(QIODevice::ReadOnly)) return std::nullopt;
+
+        QDataStream s(&file);
+        s.setVersion(QDataStream::Qt_6_0);
+
+        Snapshot snap;
+        quint32  magic { 0 }, version { 0 }, size { 0 };
+        s >> magic >> version;
+        if (magic != SnapshotMagic || version != SnapshotVersion) return std::nullopt;
+        s >> snap.cur >> snap.position;
+
+        s >> size;
+        snap.songs.reserve(size);
+        for (quint32 i = 0; i < size && s.status() == QDataStream::Ok; i++) {
+            snap.songs.emplace_back(read_song(s));
+        }
+
+        s >> size;
+        snap.shuffle.reserve(size);
+        for (quint32 i = 0; i < size && s.status() == QDataStream::Ok; i++) {
+            quint32 p { 0 };
+            s >> p;
+            snap.shuffle.push_back(p);
+        }
+
+        if (s.status() != QDataStream::Ok) {
+            WARN_LOG("broken play queue snapshot: {}", path);
+            return std::nullopt;
+        }
+        return snap;
+    }
+
+    // shuffle must be a permutation of songs
+    bool shuffle_ok() const {
+        if (shuffle.size() != songs.size()) return false;
+        std::vector<bool> seen(songs.size(), false);
+        for (auto p : shuffle) {
+            if (p >= seen.size() || seen[p]) return false;
+            seen[p] = true;
+        }
+        return true;
+    }
+
+    std::vector<model::Song> songs;
+    std::vector<quint32>     shuffle;
+    qint32                   cur { -1 };
+    qint64                   position { 0 };
+};
+
 void detail::PlayList::shuffle(iterator from, iterator end) {
     auto cur_ = cur();
+    mark_dirty((usize)std::distance(begin(), from));
     Random::shuffle(from, end);
 
     if (cur_) set_cur(cur_.value());
@@ -195,19 +359,39 @@ Playlist::Playlist(QObject* parent)
     : QAbstractListModel(parent),
       m_list(make_up<detail::PlayList>()),
       m_shuffle_list(make_up<detail::PlayList>()),
-      m_loop_mode(LoopMode::NoneLoop) {
+      m_loop_mode(LoopMode::NoneLoop),
+      m_snapshot_ex(asio::make_strand(App::instance()->get_pool_executor())),
+      m_position(0) {
     connect(this, &Playlist::curIndexChanged, this, &Playlist::check_cur, Qt::DirectConnection);
     connect(this, &Playlist::loopModeChanged, this, &Playlist::RefreshCanMove);
     connect(this, &Playlist::curIndexChanged, this, &Playlist::RefreshCanMove);
     connect(this, &QAbstractItemModel::rowsInserted, this, &Playlist::RefreshCanMove);
+
+    m_snapshot_timer.setSingleShot(true);
+    m_snapshot_timer.setInterval(SnapshotDelay);
+    m_cursor_timer.setSingleShot(true);
+    m_cursor_timer.setInterval(CursorDelay);
+    connect(&m_snapshot_timer, &QTimer::timeout, this, &Playlist::write_snapshot);
+    connect(&m_cursor_timer, &QTimer::timeout, this, &Playlist::write_cursor);
+
+    connect(this, &QAbstractItemModel::rowsInserted, this, &Playlist::schedule_snapshot);
+    connect(this, &QAbstractItemModel::rowsRemoved, this, &Playlist::schedule_snapshot);
+    connect(this, &QAbstractItemModel::modelReset, this, &Playlist::schedule_snapshot);
+    connect(this, &Playlist::loopModeChanged, this, &Playlist::schedule_snapshot);
+    connect(this, &Playlist::curIndexChanged, this, &Playlist::schedule_cursor);
 }
 
-Playlist::~Playlist() {}
+Playlist::~Playlist() {
+    if (m_snapshot_timer.isActive())
+        write_snapshot();
+    else if (m_cursor_timer.isActive())
+        write_cursor();
+}
 
 template<typename T>
     requires std::ranges::sized_range<T> &&
              std::convertible_to<std::ranges::range_value_t<T>, model::Song>
-usize Playlist::insert(int index, const T& range) {
+std::vector<QString> Playlist::insert_songs(const T& range) {
     auto filter = [this](const model::Song& s) -> bool {
         return ! m_songs.contains(sid(s));
     };
@@ -218,10 +402,10 @@ usize Playlist::insert(int index, const T& range) {
         m_songs.insert({ sid(s), s });
         ids.emplace_back(id);
     }
-    auto size = ids.size();
-    if (size == 0) return size;
+    return ids;
+}
 
-    beginInsertRows({}, index, index + size - 1);
+void Playlist::insert_ids(int index, const std::vector<QString>& ids) {
     {
         auto cur = m_list->cur();
         m_list->insert(m_list->begin() + index, std::begin(ids), std::end(ids));
@@ -232,7 +416,6 @@ usize Playlist::insert(int index, const T& range) {
         else
             m_shuffle_list->insert(it, std::begin(ids), std::end(ids));
     }
-    endInsertRows();
 
     {
         auto& list = oper_list();
@@ -241,6 +424,25 @@ usize Playlist::insert(int index, const T& range) {
             sync_list().sync_cur(list);
         }
     }
+}
+
+void Playlist::remove_id(const QString& id) {
+    m_list->erase(id);
+    m_shuffle_list->erase(id);
+    m_songs.erase(id);
+}
+
+template<typename T>
+    requires std::ranges::sized_range<T> &&
+             std::convertible_to<std::ranges::range_value_t<T>, model::Song>
+usize Playlist::insert(int index, const T& range) {
+    auto ids  = insert_songs(range);
+    auto size = ids.size();
+    if (size == 0) return size;
+
+    beginInsertRows({}, index, index + size - 1);
+    insert_ids(index, ids);
+    endInsertRows();
 
     return size;
 }
@@ -295,17 +497,209 @@ void Playlist::setCanPrev(bool v) {
     }
 }
 
+void Playlist::beginBatch() {
+    if (! m_batch) m_batch = make_up<Batch>();
+}
+
+void Playlist::commitBatch() {
+    if (auto batch = std::exchange(m_batch, nullptr)) {
+        apply_batch(*batch);
+    }
+}
+
+void Playlist::flush_batch() {
+    if (m_batch) {
+        Batch pending { std::exchange(m_batch->items, {}) };
+        apply_batch(pending);
+    }
+}
+
+void Playlist::apply_batch(const Batch& batch) {
+    if (batch.items.empty()) return;
+    CurGuard gd { *this };
+
+    if (batch.append_only()) {
+        // keep view state, one rowsInserted for all
+        insert(rowCount(), batch.items | std::views::transform(&Batch::Item::song));
+    } else {
+        beginResetModel();
+        auto& items = batch.items;
+        for (auto it = items.begin(); it != items.end(); it++) {
+            auto& id = sid(it->song);
+            switch (it->oper) {
+                using enum Batch::Oper;
+            case Append: {
+                // a run of appends is inserted at once, so shuffle spreads it like appendList
+                auto run_end = std::find_if(it, items.end(), [](const Batch::Item& i) {
+                    return i.oper != Batch::Oper::Append;
+                });
+                insert_ids(rowCount(),
+                           insert_songs(std::ranges::subrange(it, run_end) |
+                                        std::views::transform(&Batch::Item::song)));
+                it = run_end - 1;
+                break;
+            }
+            case AppendNext: {
+                if (m_songs.contains(id)) remove_id(id);
+                auto pos = std::distance(m_list->begin(), m_list->cur_it());
+                if (pos != rowCount()) pos++;
+                insert_ids(pos, insert_songs(std::array { it->song }));
+                break;
+            }
+            case Remove:
+                if (m_songs.contains(id)) remove_id(id);
+                break;
+            case Clear:
+                m_list->clear();
+                m_shuffle_list->clear();
+                m_songs.clear();
+                break;
+            }
+        }
+        endResetModel();
+    }
+    RefreshCanMove();
+}
+
+void Playlist::restore() {
+    QPointer<Playlist>    self { this };
+    asio::any_io_executor main_ex { App::instance()->get_executor() };
+    asio::post(m_snapshot_ex, [self, main_ex, path = snapshot_path()]() {
+        auto snap = Snapshot::load(path);
+        if (! snap) return;
+        asio::post(main_ex, [self, snap = std::move(snap).value()]() mutable {
+            if (self) self->apply_snapshot(std::move(snap));
+        });
+    });
+}
+
+void Playlist::apply_snapshot(Snapshot&& snap) {
+    // user already queued something before restore finished
+    if (rowCount() != 0 || snap.songs.empty()) return;
+    CurGuard gd { *this };
+
+    // cur indexes the saved list, resolve it before repeated ids are dropped
+    std::optional<QString> saved_cur;
+    if (snap.cur >= 0 && (usize)snap.cur < snap.songs.size())
+        saved_cur = sid(snap.songs[snap.cur]);
+
+    // drop repeated ids before announcing the rows
+    std::vector<QString> ids;
+    ids.reserve(snap.songs.size());
+    for (auto& s : snap.songs) {
+        if (m_songs.contains(sid(s))) continue;
+        ids.emplace_back(sid(s));
+        m_songs.insert({ sid(s), std::move(s) });
+    }
+
+    beginInsertRows({}, 0, ids.size() - 1);
+    {
+        m_list->insert(m_list->begin(), std::begin(ids), std::end(ids));
+
+        if (ids.size() == snap.songs.size() && snap.shuffle_ok()) {
+            auto shuffled = snap.shuffle | std::views::transform([&ids](quint32 p) {
+                                return ids[p];
+                            });
+            std::vector<QString> shuffle_ids { std::begin(shuffled), std::end(shuffled) };
+            m_shuffle_list->insert(
+                m_shuffle_list->begin(), std::begin(shuffle_ids), std::end(shuffle_ids));
+        } else {
+            *m_shuffle_list = *m_list;
+            m_shuffle_list->shuffle(m_shuffle_list->begin(), m_shuffle_list->end());
+        }
+
+        if (saved_cur) {
+            m_list->set_cur(saved_cur.value());
+            m_shuffle_list->set_cur(saved_cur.value());
+        } else {
+            oper_list().try_set_cur_frist();
+            sync_list().sync_cur(oper_list());
+        }
+    }
+    endInsertRows();
+
+    // the position belongs to the saved cur, meaningless for the fallback
+    m_position = saved_cur ? snap.position : 0;
+    emit restored(m_position);
+}
+
+void Playlist::recordPosition(qint64 v) {
+    m_position = v;
+    schedule_cursor();
+}
+
+void Playlist::schedule_snapshot() {
+    if (! m_snapshot_timer.isActive()) m_snapshot_timer.start();
+}
+
+void Playlist::schedule_cursor() {
+    if (! m_cursor_timer.isActive()) m_cursor_timer.start();
+}
+
+void Playlist::write_snapshot() {
+    m_snapshot_timer.stop();
+    m_cursor_timer.stop();
+
+    QByteArray buf;
+    {
+        QDataStream s(&buf, QIODevice::WriteOnly);
+        s.setVersion(QDataStream::Qt_6_0);
+
+        auto cur = m_list->cur_pos();
+        s << SnapshotMagic << SnapshotVersion;
+        s << (qint32)(cur ? (qint32)cur.value() : -1) << m_position;
+
+        s << (quint32)m_list->size();
+        for (auto& id : *m_list) write_song(s, m_songs.at(id));
+        s << (quint32)m_shuffle_list->size();
+        for (auto& id : *m_shuffle_list) s << (quint32)m_list->pos(id).value();
+    }
+
+    asio::post(m_snapshot_ex, [buf, path = snapshot_path()]() {
+        QSaveFile file(path);
+        if (file.open(QIODevice::WriteOnly) && file.write(buf) == buf.size() && file.commit()) {
+            return;
+        }
+        ERROR_LOG("write play queue snapshot failed: {}", file.errorString());
+    });
+}
+
+void Playlist::write_cursor() {
+    // cursor is part of the pending full snapshot
+    if (m_snapshot_timer.isActive()) return;
+
+    auto cur = m_list->cur_pos();
+    asio::post(m_snapshot_ex,
+               [buf  = serialize_cursor(cur ? (qint32)cur.value() : -1, m_position),
+                path = snapshot_path()]() {
+                   QFile file(path);
+                   if (! file.open(QIODevice::ReadWrite) ||
+                       file.size() < SnapshotCursorOffset + SnapshotCursorSize)
+                       return;
+                   file.seek(SnapshotCursorOffset);
+                   file.write(buf);
+               });
+}
+
 void Playlist::switchList(const std::vector<model::Song>& songs) {
     auto old_id = m_cur.id;
-    clear();
+    flush_batch();
 
-    insert(0, songs);
+    // clear and insert under one model reset
+    Batch batch;
+    batch.items.push_back({ Batch::Oper::Clear, {} });
+    batch.append(songs);
+    apply_batch(batch);
     emit curIndexChanged(true);
 }
 
 void Playlist::switchTo(const model::Song& song) {
+    flush_batch();
     if (! m_songs.contains(sid(song))) {
+        // insert now, an open batch would only queue it
+        auto batch = std::exchange(m_batch, nullptr);
         appendNext(song);
+        m_batch = std::move(batch);
     }
     m_list->set_cur(sid(song));
     m_shuffle_list->set_cur(sid(song));
@@ -314,6 +708,10 @@ void Playlist::switchTo(const model::Song& song) {
 }
 
 void Playlist::appendNext(const model::Song& song) {
+    if (m_batch) {
+        m_batch->items.push_back({ Batch::Oper::AppendNext, song });
+        return;
+    }
     remove(sid(song));
 
     auto pos = std::distance(m_list->begin(), m_list->cur_it());
@@ -321,28 +719,43 @@ void Playlist::appendNext(const model::Song& song) {
     insert(pos, std::array { song });
 }
 
-void Playlist::append(const model::Song& song) { insert(rowCount(), std::array { song }); }
+void Playlist::append(const model::Song& song) {
+    if (m_batch) {
+        m_batch->items.push_back({ Batch::Oper::Append, song });
+        return;
+    }
+    insert(rowCount(), std::array { song });
+}
 
 void Playlist::remove(model::SongId id) {
+    if (m_batch) {
+        model::Song song;
+        song.id = id;
+        m_batch->items.push_back({ Batch::Oper::Remove, song });
+        return;
+    }
     if (! m_songs.contains(id.id)) return;
     CurGuard gd { *this };
 
     auto pos = m_list->pos(id.id).value();
     beginRemoveRows({}, pos, pos);
-
-    m_list->erase(m_list->begin() + pos);
-    m_shuffle_list->erase(id.id);
-    m_songs.erase(id.id);
-
+    remove_id(id.id);
     endRemoveRows();
 }
 
 void Playlist::appendList(const std::vector<model::Song>& songs) {
-    insert(rowCount(), songs);
+    if (m_batch) {
+        m_batch->append(songs);
+        return;
+    }
+    Batch batch;
+    batch.append(songs);
+    apply_batch(batch);
     emit curIndexChanged(false);
 }
 
 void Playlist::clear() {
+    if (m_batch) m_batch->items.clear();
     CurGuard gd { *this };
     beginResetModel();
     m_list->clear();
@@ -352,6 +765,7 @@ void Playlist::clear() {
 }
 
 void Playlist::next() {
+    flush_batch();
     CurGuard gd { *this, true };
 
     auto& list = oper_list();
@@ -370,6 +784,7 @@ void Playlist::next() {
     sync_list().sync_cur(list);
 }
 void Playlist::prev() {
+    flush_batch();
     CurGuard gd { *this, true };
 
     auto& list = oper_list();
@@ -0,0 +1,50 @@
+#include "alloc_count.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+std::atomic<std::uint64_t> g_count { 0 };
+std::atomic<std::uint64_t> g_bytes { 0 };
+
+void* counted_alloc(std::size_t size, std::size_t align) {
+    g_count.fetch_add(1, std::memory_order_relaxed);
+    g_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (size == 0) size = 1;
+    return align > alignof(std::max_align_t)
+               ? std::aligned_alloc(align, (size + align - 1) / align * align)
+               : std::malloc(size);
+}
+} // namespace
+
+std::uint64_t bench::allocations() { return g_count.load(std::memory_order_relaxed); }
+std::uint64_t bench::allocated_bytes() { return g_bytes.load(std::memory_order_relaxed); }
+
+void* operator new(std::size_t size) {
+    if (auto p = counted_alloc(size, 0)) return p;
+    throw std::bad_alloc {};
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void* operator new(std::size_t size, std::align_val_t al) {
+    if (auto p = counted_alloc(size, (std::size_t)al)) return p;
+    throw std::bad_alloc {};
+}
+void* operator new[](std::size_t size, std::align_val_t al) { return operator new(size, al); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return counted_alloc(size, 0);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return counted_alloc(size, 0);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
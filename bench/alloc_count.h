@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+// global operator new replacement, linked into every benchmark
+namespace bench
+{
+
+std::uint64_t allocations();
+std::uint64_t allocated_bytes();
+
+// allocations between construction and now, all threads
+class AllocScope {
+public:
+    AllocScope(): m_count(allocations()), m_bytes(allocated_bytes()) {}
+
+    std::uint64_t count() const { return allocations() - m_count; }
+    std::uint64_t bytes() const { return allocated_bytes() - m_bytes; }
+
+private:
+    std::uint64_t m_count;
+    std::uint64_t m_bytes;
+};
+
+} // namespace bench
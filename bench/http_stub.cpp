@@ -0,0 +1,145 @@
+#include "http_stub.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+
+#include <asio/as_tuple.hpp>
+#include <asio/co_spawn.hpp>
+#include <asio/detached.hpp>
+#include <asio/read_until.hpp>
+#include <asio/streambuf.hpp>
+#include <asio/use_awaitable.hpp>
+#include <asio/write.hpp>
+
+#include "core/log.h"
+
+using namespace bench;
+
+namespace
+{
+
+// case insensitive, value up to the line end
+std::optional<std::string_view> header_value(std::string_view head, std::string_view lower_name) {
+    std::string lower(head);
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) {
+        return std::tolower(c);
+    });
+    auto pos = lower.find(fmt::format("\n{}:", lower_name));
+    if (pos == std::string::npos) return std::nullopt;
+    pos += lower_name.size() + 2;
+    auto end = head.find("\r\n", pos);
+    auto v   = head.substr(pos, end - pos);
+    while (! v.empty() && v.front() == ' ') v.remove_prefix(1);
+    return v;
+}
+
+std::optional<usize> to_number(std::string_view v) {
+    usize out { 0 };
+    auto [ptr, ec] = std::from_chars(v.data(), v.data() + v.size(), out);
+    if (ec != std::errc {}) return std::nullopt;
+    return out;
+}
+
+} // namespace
+
+HttpStub::HttpStub(usize body_size, usize threads): m_pool(threads), m_acceptor(m_pool) {
+    m_body.resize(body_size);
+    for (usize i = 0; i < body_size; i++) m_body[i] = (char)('a' + i % 26);
+
+    auto end = asio::ip::tcp::endpoint(asio::ip::make_address_v4("127.0.0.1"), 0);
+    m_acceptor.open(end.protocol());
+    m_acceptor.bind(end);
+    m_acceptor.listen();
+
+    asio::co_spawn(m_pool, listen(), asio::detached);
+}
+
+HttpStub::~HttpStub() {
+    // pending connections are dropped with the pool
+    m_pool.stop();
+    m_pool.join();
+    m_acceptor.close();
+}
+
+u16 HttpStub::port() const { return m_acceptor.local_endpoint().port(); }
+
+std::string HttpStub::url(std::string_view path) const {
+    return fmt::format("http://127.0.0.1:{}/{}", port(), path);
+}
+
+asio::awaitable<void> HttpStub::listen() {
+    for (;;) {
+        auto [ec, socket] = co_await m_acceptor.async_accept(asio::as_tuple(asio::use_awaitable));
+        if (ec) break;
+        auto ex = socket.get_executor();
+        asio::co_spawn(ex, serve(std::move(socket)), asio::detached);
+    }
+}
+
+asio::awaitable<void> HttpStub::serve(asio::ip::tcp::socket s) {
+    asio::streambuf        buf;
+    std::array<char, 8192> drop;
+    for (;;) {
+        auto [ec, n] = co_await asio::async_read_until(
+            s, buf, "\r\n\r\n", asio::as_tuple(asio::use_awaitable));
+        if (ec) co_return;
+
+        std::string head { asio::buffers_begin(buf.data()), asio::buffers_begin(buf.data()) + n };
+        buf.consume(n);
+
+        bool is_post = head.starts_with("POST ");
+        if (is_post) {
+            // drop the request body
+            auto need = to_number(header_value(head, "content-length").value_or("0")).value_or(0);
+            auto have = std::min(need, buf.size());
+            buf.consume(have);
+            need -= have;
+            while (need > 0) {
+                auto [r_ec, got] = co_await s.async_read_some(
+                    asio::buffer(drop.data(), std::min(need, drop.size())),
+                    asio::as_tuple(asio::use_awaitable));
+                if (r_ec) co_return;
+                need -= got;
+            }
+        }
+
+        std::string      rsp;
+        std::string_view body;
+        if (is_post) {
+            body = "ok";
+            rsp  = fmt::format("HTTP/1.1 200 OK\r\nContent-Length: {}\r\n"
+                               "Content-Type: text/plain\r\n\r\n",
+                              body.size());
+        } else {
+            usize start { 0 };
+            if (auto range = header_value(head, "range"); range && range->starts_with("bytes=")) {
+                range->remove_prefix(6);
+                start = std::min(to_number(range->substr(0, range->find('-'))).value_or(0),
+                                 m_body.size());
+            }
+            body = std::string_view { m_body }.substr(start);
+            if (start > 0) {
+                rsp = fmt::format("HTTP/1.1 206 Partial Content\r\nContent-Length: {}\r\n"
+                                  "Content-Range: bytes {}-{}/{}\r\n",
+                                  body.size(),
+                                  start,
+                                  m_body.size() - 1,
+                                  m_body.size());
+            } else {
+                rsp = fmt::format("HTTP/1.1 200 OK\r\nContent-Length: {}\r\n", body.size());
+            }
+            rsp.append("Content-Type: audio/mpeg\r\nAccept-Ranges: bytes\r\n\r\n");
+        }
+
+        std::array<asio::const_buffer, 2> bufs { asio::buffer(rsp),
+                                                 asio::buffer(body.data(), body.size()) };
+        auto [w_ec, w_n] = co_await asio::async_write(s, bufs, asio::as_tuple(asio::use_awaitable));
+        if (w_ec) co_return;
+
+        if (auto conn = header_value(head, "connection"); conn && conn->starts_with("close")) {
+            co_return;
+        }
+    }
+}
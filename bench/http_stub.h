@@ -0,0 +1,34 @@
+#pragma once
+
+#include <asio/awaitable.hpp>
+#include <asio/ip/tcp.hpp>
+#include <asio/thread_pool.hpp>
+
+#include "core/core.h"
+
+namespace bench
+{
+
+// loopback http/1.1 server standing in for the real upstream, keep alive
+//   GET  any path, body() with range support
+//   POST any path, request body is read and dropped, replies "ok"
+class HttpStub : NoCopy {
+public:
+    HttpStub(usize body_size, usize threads = 2);
+    ~HttpStub();
+
+    u16         port() const;
+    std::string url(std::string_view path) const;
+
+    const std::string& body() const { return m_body; }
+
+private:
+    asio::awaitable<void> listen();
+    asio::awaitable<void> serve(asio::ip::tcp::socket);
+
+    asio::thread_pool       m_pool;
+    asio::ip::tcp::acceptor m_acceptor;
+    std::string             m_body;
+};
+
+} // namespace bench
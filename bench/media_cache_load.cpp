@@ -0,0 +1,282 @@
+// media_cache::Server load test
+//
+// the server proxies a local HttpStub, clients issue concurrent requests
+//   cold  every request is a new id, goes through http_source, files dropped after each
+//         iteration so a tmpfs /tmp does not fill up
+//   warm  ids already cached, goes through file_source
+//   seek  range requests at random offsets, half cached and half new
+// reports throughput, p50/p99 latency, time to first byte and bytes copied
+
+#include <benchmark/benchmark.h>
+
+#include <asio/as_tuple.hpp>
+#include <asio/co_spawn.hpp>
+#include <asio/connect.hpp>
+#include <asio/use_awaitable.hpp>
+#include <asio/use_future.hpp>
+#include <asio/write.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "core/log.h"
+#include "media_cache/media_cache.h"
+#include "request/request.h"
+#include "request/session.h"
+
+#include "alloc_count.h"
+#include "http_stub.h"
+#include "shared.h"
+
+namespace
+{
+
+constexpr usize BodySize { 4 * 1024 * 1024 };
+constexpr usize WarmIds { 16 };
+constexpr usize RequestsPerClient { 4 };
+constexpr std::string_view ColdPrefix { "cold" };
+
+enum class Mode
+{
+    Cold = 0,
+    Warm,
+    Seek,
+};
+
+class MemDb : public media_cache::DataBase {
+public:
+    asio::awaitable<std::optional<Item>> get(std::string key) override {
+        std::lock_guard lock { m_mutex };
+        if (auto it = m_items.find(key); it != m_items.end()) co_return it->second;
+        co_return std::nullopt;
+    }
+    asio::awaitable<void> insert(Item item) override {
+        std::lock_guard lock { m_mutex };
+        m_items.try_emplace(item.key, item);
+        co_return;
+    }
+    bool contains(const std::string& key) {
+        std::lock_guard lock { m_mutex };
+        return m_items.contains(key);
+    }
+    void erase_prefix(std::string_view prefix) {
+        std::lock_guard lock { m_mutex };
+        std::erase_if(m_items, [prefix](const auto& el) {
+            return el.first.starts_with(prefix);
+        });
+    }
+
+private:
+    std::mutex                  m_mutex;
+    std::map<std::string, Item> m_items;
+};
+
+struct Sample {
+    double ttfb_ms { 0 };
+    double total_ms { 0 };
+    u64    bytes { 0 };
+};
+
+double ms_since(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+
+// one request on a fresh connection, read until the server closes
+asio::awaitable<Sample> fetch(u16 port, std::string target, std::optional<usize> range) {
+    auto ex = co_await asio::this_coro::executor;
+
+    asio::ip::tcp::socket s { ex };
+    auto                  begin = std::chrono::steady_clock::now();
+    co_await s.async_connect({ asio::ip::make_address_v4("127.0.0.1"), port },
+                             asio::use_awaitable);
+
+    auto req = fmt::format("GET {} HTTP/1.1\r\nHost: 127.0.0.1:{}\r\n", target, port);
+    if (range) req.append(fmt::format("Range: bytes={}-\r\n", *range));
+    req.append("\r\n");
+    co_await asio::async_write(s, asio::buffer(req), asio::use_awaitable);
+
+    Sample                      out;
+    std::array<char, 64 * 1024> buf;
+    for (;;) {
+        auto [ec, n] = co_await s.async_read_some(asio::buffer(buf),
+                                                  asio::as_tuple(asio::use_awaitable));
+        if (n > 0 && out.bytes == 0) out.ttfb_ms = ms_since(begin);
+        out.bytes += n;
+        if (ec) break;
+    }
+    out.total_ms = ms_since(begin);
+    co_return out;
+}
+
+class Fixture {
+public:
+    Fixture()
+        : m_pool(4),
+          m_client_pool(4),
+          m_upstream(BodySize),
+          m_session(make_rc<request::Session>(m_pool.get_executor())),
+          m_cache(m_pool.get_executor(), m_session),
+          m_db(make_rc<MemDb>()),
+          m_dir(std::filesystem::temp_directory_path() / "qcm_bench_media_cache") {
+        std::filesystem::remove_all(m_dir);
+        m_cache.start(m_dir, m_db);
+
+        // fill the cache once, the server inserts after the last byte
+        for (usize i = 0; i < WarmIds; i++) run_one(warm_id(i), std::nullopt);
+        for (usize i = 0; i < WarmIds; i++) {
+            for (int n = 0; n < 500 && ! m_db->contains(warm_id(i)); n++)
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    ~Fixture() {
+        m_cache.stop();
+        m_session->about_to_stop();
+        m_client_pool.join();
+        m_pool.join();
+        std::error_code ec;
+        std::filesystem::remove_all(m_dir, ec);
+    }
+
+    static std::string warm_id(usize i) { return fmt::format("warm{}", i); }
+    std::string        cold_id() { return fmt::format("{}{}", ColdPrefix, m_next_cold++); }
+
+    // cold ids are never requested again, remove their files and rows
+    // an insert still in flight leaves a row behind, the next call drops it
+    void drop_cold() {
+        std::error_code ec;
+        for (auto it = std::filesystem::directory_iterator(m_dir, ec);
+             ! ec && it != std::filesystem::directory_iterator();
+             it.increment(ec)) {
+            if (! it->path().filename().native().starts_with(ColdPrefix)) continue;
+            std::error_code rm_ec;
+            std::filesystem::remove(it->path(), rm_ec);
+        }
+        m_db->erase_prefix(ColdPrefix);
+    }
+
+    std::string target(const std::string& id) const {
+        // keep the path and query, the client connects by port
+        auto url = m_cache.get_url(m_upstream.url(id), id);
+        return url.substr(url.find('/', std::string_view("http://").size()));
+    }
+
+    Sample run_one(std::string id, std::optional<usize> range) {
+        return asio::co_spawn(m_client_pool, fetch(port(), target(id), range), asio::use_future)
+            .get();
+    }
+
+    // clients in parallel, each with RequestsPerClient requests in a row
+    std::vector<Sample> run(Mode mode, usize clients, std::mt19937& rng) {
+        std::vector<std::pair<std::string, std::optional<usize>>> reqs;
+        for (usize i = 0; i < clients * RequestsPerClient; i++) {
+            std::uniform_int_distribution<usize> pick(0, WarmIds - 1), offset(0, BodySize - 1);
+            switch (mode) {
+            case Mode::Cold: reqs.emplace_back(cold_id(), std::nullopt); break;
+            case Mode::Warm: reqs.emplace_back(warm_id(pick(rng)), std::nullopt); break;
+            case Mode::Seek:
+                reqs.emplace_back(i % 2 ? warm_id(pick(rng)) : cold_id(), offset(rng));
+                break;
+            }
+        }
+
+        std::vector<std::future<std::vector<Sample>>> futures;
+        for (usize c = 0; c < clients; c++) {
+            auto client = [this, port = port(), reqs, c]() -> asio::awaitable<std::vector<Sample>> {
+                std::vector<Sample> out;
+                for (usize i = 0; i < RequestsPerClient; i++) {
+                    auto& [id, range] = reqs[c * RequestsPerClient + i];
+                    out.push_back(co_await fetch(port, target(id), range));
+                }
+                co_return out;
+            };
+            futures.push_back(asio::co_spawn(m_client_pool, client, asio::use_future));
+        }
+
+        std::vector<Sample> out;
+        for (auto& f : futures) {
+            auto samples = f.get();
+            out.insert(out.end(), samples.begin(), samples.end());
+        }
+        return out;
+    }
+
+    u16 port() const { return (u16)m_cache.port(); }
+
+private:
+    asio::thread_pool       m_pool;
+    asio::thread_pool       m_client_pool;
+    bench::HttpStub         m_upstream;
+    rc<request::Session>    m_session;
+    media_cache::MediaCache m_cache;
+    rc<MemDb>               m_db;
+    std::filesystem::path   m_dir;
+    std::atomic<usize>      m_next_cold { 0 };
+};
+
+double percentile(std::vector<double>& v, double q) {
+    if (v.empty()) return 0;
+    auto idx = std::min(v.size() - 1, (usize)(q * (v.size() - 1) + 0.5));
+    std::nth_element(v.begin(), v.begin() + idx, v.end());
+    return v[idx];
+}
+
+void BM_load(benchmark::State& state) {
+    auto  mode    = (Mode)state.range(0);
+    auto  clients = (usize)state.range(1);
+    auto& f       = bench::Shared<Fixture>::get();
+
+    std::mt19937        rng { 42 };
+    std::vector<double> total, ttfb;
+    u64                 bytes { 0 }, allocs { 0 }, requests { 0 };
+
+    for (auto _ : state) {
+        bench::AllocScope alloc;
+        for (auto& s : f.run(mode, clients, rng)) {
+            total.push_back(s.total_ms);
+            ttfb.push_back(s.ttfb_ms);
+            bytes += s.bytes;
+            ++requests;
+        }
+        allocs += alloc.count();
+
+        if (mode != Mode::Warm) {
+            state.PauseTiming();
+            f.drop_cold();
+            state.ResumeTiming();
+        }
+    }
+
+    state.SetBytesProcessed((i64)bytes);
+    state.SetItemsProcessed((i64)requests);
+    state.counters["p50_ms"]         = percentile(total, 0.5);
+    state.counters["p99_ms"]         = percentile(total, 0.99);
+    state.counters["ttfb_p50_ms"]    = percentile(ttfb, 0.5);
+    state.counters["ttfb_p99_ms"]    = percentile(ttfb, 0.99);
+    state.counters["allocs_per_req"] = (double)allocs / std::max<u64>(requests, 1);
+}
+
+} // namespace
+
+BENCHMARK(BM_load)
+    ->ArgNames({ "mode", "clients" })
+    ->ArgsProduct({ { (i64)Mode::Cold, (i64)Mode::Warm, (i64)Mode::Seek }, { 1, 8, 32 } })
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+int main(int argc, char** argv) {
+    auto logger = qcm::LogManager::init();
+    logger->set_level(qcm::LogLevel::ERROR);
+    request::global_init();
+
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    bench::Shared<Fixture>::reset();
+    return 0;
+}
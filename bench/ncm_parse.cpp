@@ -0,0 +1,498 @@
+// ncm api model parse and convert benchmark
+//
+// fixtures are generated with the field layout of recorded responses, including the fields
+// the models skip, with made up ids, names and urls
+//   playlist_detail  1000 tracks with privileges and trackIds
+//   cloudsearch      one page of songs
+//   comments         one page with hot and top comments
+//   user_cloud       one page of cloud items
+// parse    bytes -> api_model through api_model::parse<T>
+// convert  api_model -> qcm::model, what handle_output does before touching the list model
+
+#include <benchmark/benchmark.h>
+
+#include <nlohmann/json.hpp>
+
+#include <random>
+
+#include "core/log.h"
+#include "core/vec_helper.h"
+
+#include "ncm/api/cloudsearch.h"
+#include "ncm/api/comments.h"
+#include "ncm/api/playlist_detail.h"
+#include "ncm/api/user_cloud.h"
+
+#include "Qcm/model.h"
+#include "Qcm/model/user_cloud.h"
+
+#include "alloc_count.h"
+
+using njson = nlohmann::json;
+
+namespace
+{
+
+constexpr i64 PlaylistTracks { 1000 };
+constexpr i64 SearchLimit { 30 };
+constexpr i64 CommentLimit { 20 };
+constexpr i64 CloudLimit { 30 };
+
+// fixed epoch, 2023-03-01
+constexpr i64 BaseTime { 1677600000000 };
+
+class Gen {
+public:
+    Gen(): m_rng(20230301) {}
+
+    i64  id() { return std::uniform_int_distribution<i64>(100000, 2000000000)(m_rng); }
+    i64  num(i64 lo, i64 hi) { return std::uniform_int_distribution<i64>(lo, hi)(m_rng); }
+    bool flag() { return num(0, 1); }
+
+    // mixed ascii and cjk, like real titles
+    std::string name(std::string_view prefix) {
+        static constexpr std::array words { "夜", "光", "风", "海", "Love", "Night",
+                                            "Blue", "雨", "梦", "Live", "Remix", "城市" };
+        std::string out { prefix };
+        for (i64 i = 0, n = num(1, 4); i < n; i++) {
+            out.push_back(' ');
+            out.append(words[num(0, words.size() - 1)]);
+        }
+        return out;
+    }
+    std::string pic_url() {
+        return fmt::format("https://p{}.example.invalid/{:x}/{}.jpg", num(1, 4), id(), id());
+    }
+    i64 time() { return BaseTime - num(0, 5LL * 365 * 24 * 3600 * 1000); }
+
+    njson quality(i64 br) {
+        return { { "br", br },
+                 { "fid", 0 },
+                 { "size", num(1, 50) * 1000000 },
+                 { "vd", -num(1000, 90000) },
+                 { "sr", 44100 } };
+    }
+
+    njson artist() {
+        return { { "id", id() }, { "name", name("artist") }, { "tns", njson::array() },
+                 { "alias", njson::array() }, { "alia", njson::array({ name("aka") }) } };
+    }
+
+    njson song(i64 id_) {
+        auto ar = njson::array();
+        for (i64 i = 0, n = num(1, 3); i < n; i++) ar.push_back(artist());
+        njson al { { "id", id() }, { "name", name("album") }, { "picUrl", pic_url() },
+                   { "tns", njson::array() }, { "pic_str", std::to_string(id()) },
+                   { "pic", id() } };
+        return {
+            { "name", name("song") },
+            { "id", id_ },
+            { "pst", 0 },
+            { "t", 0 },
+            { "ar", ar },
+            { "alia", flag() ? njson::array({ name("aka") }) : njson::array() },
+            { "pop", num(0, 100) },
+            { "st", 0 },
+            { "rt", flag() ? njson(nullptr) : njson("") },
+            { "fee", num(0, 8) },
+            { "v", num(1, 100) },
+            { "crbt", nullptr },
+            { "cf", "" },
+            { "al", al },
+            { "dt", num(120, 420) * 1000 },
+            { "h", quality(320000) },
+            { "m", quality(192000) },
+            { "l", quality(128000) },
+            { "sq", flag() ? quality(999000) : njson(nullptr) },
+            { "hr", nullptr },
+            { "a", nullptr },
+            { "cd", "01" },
+            { "no", num(1, 20) },
+            { "rtUrl", nullptr },
+            { "ftype", 0 },
+            { "rtUrls", njson::array() },
+            { "djId", 0 },
+            { "copyright", num(0, 2) },
+            { "s_id", 0 },
+            { "mark", num(0, 1 << 20) },
+            { "originCoverType", num(0, 2) },
+            { "originSongSimpleData", nullptr },
+            { "tagPicList", nullptr },
+            { "resourceState", true },
+            { "version", num(1, 30) },
+            { "songJumpInfo", nullptr },
+            { "entertainmentTags", nullptr },
+            { "awardTags", nullptr },
+            { "single", 0 },
+            { "noCopyrightRcmd", nullptr },
+            { "rtype", 0 },
+            { "rurl", nullptr },
+            { "mst", 9 },
+            { "cp", id() % 10000000 },
+            { "mv", flag() ? id() : 0 },
+            { "publishTime", time() },
+        };
+    }
+
+    njson privilege(i64 id_) {
+        return {
+            { "id", id_ },
+            { "fee", 8 },
+            { "payed", 0 },
+            { "st", 0 },
+            { "pl", 320000 },
+            { "dl", 999000 },
+            { "sp", 7 },
+            { "cp", 1 },
+            { "subp", 1 },
+            { "cs", false },
+            { "maxbr", 999000 },
+            { "fl", 320000 },
+            { "toast", false },
+            { "flag", num(0, 300) },
+            { "preSell", false },
+            { "playMaxbr", 999000 },
+            { "downloadMaxbr", 999000 },
+            { "maxBrLevel", "lossless" },
+            { "playMaxBrLevel", "lossless" },
+            { "downloadMaxBrLevel", "lossless" },
+            { "plLevel", "exhigh" },
+            { "dlLevel", "lossless" },
+            { "flLevel", "exhigh" },
+            { "rscl", nullptr },
+            { "freeTrialPrivilege",
+              { { "resConsumable", false },
+                { "userConsumable", false },
+                { "listenType", nullptr } } },
+            { "chargeInfoList", njson::array() },
+        };
+    }
+
+    njson user() {
+        return {
+            { "locationInfo", nullptr },
+            { "liveInfo", nullptr },
+            { "anonym", 0 },
+            { "commonIdentity", nullptr },
+            { "avatarDetail", nullptr },
+            { "userType", 0 },
+            { "avatarUrl", pic_url() },
+            { "followed", false },
+            { "mutual", false },
+            { "remarkName", nullptr },
+            { "socialUserId", nullptr },
+            { "vipRights", nullptr },
+            { "nickname", name("user") },
+            { "authStatus", 0 },
+            { "expertTags", nullptr },
+            { "experts", nullptr },
+            { "vipType", num(0, 11) },
+            { "userId", id() },
+            { "target", nullptr },
+        };
+    }
+
+    njson comment() {
+        std::string content;
+        for (i64 i = 0, n = num(1, 12); i < n; i++) content.append(name("line")).push_back('\n');
+        return {
+            { "user", user() },
+            { "beReplied", njson::array() },
+            { "pendantData", nullptr },
+            { "showFloorComment", nullptr },
+            { "status", 0 },
+            { "commentId", id() },
+            { "content", content },
+            { "richContent", nullptr },
+            { "contentResource", nullptr },
+            { "time", time() },
+            { "timeStr", "03-01" },
+            { "needDisplayTime", true },
+            { "likedCount", num(0, 100000) },
+            { "expressionUrl", nullptr },
+            { "commentLocationType", 0 },
+            { "parentCommentId", 0 },
+            { "decoration", njson::object() },
+            { "repliedMark", nullptr },
+            { "grade", nullptr },
+            { "userBizLevels", nullptr },
+            { "ipLocation", { { "ip", nullptr }, { "location", "" }, { "userId", nullptr } } },
+            { "owner", false },
+            { "liked", false },
+        };
+    }
+
+    njson cloud_item() {
+        auto s  = song(id());
+        auto sz = num(3, 60) * 1000000;
+        return {
+            { "simpleSong", s },
+            { "cover", 0 },
+            { "coverId", "" },
+            { "lyricId", "" },
+            { "album", s["al"]["name"] },
+            { "artist", s["ar"][0]["name"] },
+            { "bitrate", 320 },
+            { "songId", s["id"] },
+            { "addTime", time() },
+            { "songName", s["name"] },
+            { "version", num(1, 5) },
+            { "fileSize", sz },
+            { "fileName", fmt::format("{}.mp3", s["name"].get<std::string>()) },
+        };
+    }
+
+private:
+    std::mt19937_64 m_rng;
+};
+
+std::string playlist_detail() {
+    Gen   g;
+    njson tracks = njson::array(), privileges = njson::array(), ids = njson::array();
+    for (i64 i = 0; i < PlaylistTracks; i++) {
+        auto id = g.id();
+        tracks.push_back(g.song(id));
+        privileges.push_back(g.privilege(id));
+        ids.push_back({ { "id", id }, { "v", g.num(1, 50) }, { "t", 0 }, { "at", g.time() },
+                        { "alg", nullptr }, { "uid", g.id() }, { "rcmdReason", "" },
+                        { "sc", nullptr }, { "f", nullptr }, { "sr", nullptr } });
+    }
+    njson playlist {
+        { "id", g.id() },
+        { "name", g.name("playlist") },
+        { "coverImgId", g.id() },
+        { "coverImgUrl", g.pic_url() },
+        { "coverImgId_str", std::to_string(g.id()) },
+        { "adType", 0 },
+        { "userId", g.id() },
+        { "createTime", g.time() },
+        { "status", 0 },
+        { "opRecommend", false },
+        { "highQuality", false },
+        { "newImported", false },
+        { "updateTime", g.time() },
+        { "trackCount", PlaylistTracks },
+        { "specialType", 0 },
+        { "privacy", 0 },
+        { "trackUpdateTime", g.time() },
+        { "commentThreadId", fmt::format("A_PL_0_{}", g.id()) },
+        { "playCount", g.num(0, 10000000) },
+        { "trackNumberUpdateTime", g.time() },
+        { "subscribedCount", g.num(0, 100000) },
+        { "cloudTrackCount", 0 },
+        { "ordered", true },
+        { "description", g.name("description") },
+        { "tags", njson::array({ "华语", "流行" }) },
+        { "updateFrequency", nullptr },
+        { "backgroundCoverId", 0 },
+        { "backgroundCoverUrl", nullptr },
+        { "titleImage", 0 },
+        { "titleImageUrl", nullptr },
+        { "englishTitle", nullptr },
+        { "officialPlaylistType", nullptr },
+        { "copied", false },
+        { "relateResType", nullptr },
+        { "subscribers", njson::array() },
+        { "subscribed", false },
+        { "creator", g.user() },
+        { "tracks", tracks },
+        { "videoIds", nullptr },
+        { "videos", nullptr },
+        { "trackIds", ids },
+        { "bannedTrackIds", nullptr },
+        { "shareCount", g.num(0, 10000) },
+        { "commentCount", g.num(0, 10000) },
+        { "remixVideo", nullptr },
+        { "sharedUsers", nullptr },
+        { "historySharedUsers", nullptr },
+        { "gradeStatus", "NONE" },
+        { "score", nullptr },
+        { "algTags", nullptr },
+    };
+    njson out {
+        { "code", 200 },
+        { "relatedVideos", nullptr },
+        { "playlist", playlist },
+        { "urls", nullptr },
+        { "privileges", privileges },
+        { "sharedPrivilege", nullptr },
+        { "resEntrance", nullptr },
+    };
+    return out.dump();
+}
+
+std::string cloudsearch() {
+    Gen   g;
+    njson songs = njson::array();
+    for (i64 i = 0; i < SearchLimit; i++) {
+        auto id = g.id();
+        auto s  = g.song(id);
+        s["privilege"] = g.privilege(id);
+        songs.push_back(s);
+    }
+    njson out {
+        { "result",
+          { { "searchQcReminder", nullptr }, { "songs", songs }, { "songCount", 300 } } },
+        { "code", 200 },
+    };
+    return out.dump();
+}
+
+std::string comments() {
+    Gen  g;
+    auto page = [&g](i64 n) {
+        auto out = njson::array();
+        for (i64 i = 0; i < n; i++) out.push_back(g.comment());
+        return out;
+    };
+    njson out {
+        { "isMusician", false },
+        { "cnum", 0 },
+        { "userId", -1 },
+        { "topComments", page(1) },
+        { "moreHot", true },
+        { "hotComments", page(15) },
+        { "commentBanner", nullptr },
+        { "code", 200 },
+        { "comments", page(CommentLimit) },
+        { "total", 10000 },
+        { "more", true },
+    };
+    return out.dump();
+}
+
+std::string user_cloud() {
+    Gen   g;
+    njson data = njson::array();
+    for (i64 i = 0; i < CloudLimit; i++) data.push_back(g.cloud_item());
+    njson out {
+        { "data", data },
+        { "count", 300 },
+        { "size", "3000000000" },
+        { "maxSize", "64424509440" },
+        { "upgradeSign", 0 },
+        { "hasMore", true },
+        { "code", 200 },
+    };
+    return out.dump();
+}
+
+std::span<const byte> as_bytes(const std::string& s) {
+    return { (const byte*)s.data(), s.size() };
+}
+
+template<typename T, typename In>
+void BM_parse(benchmark::State& state, std::string json) {
+    In  in {};
+    u64 allocs { 0 };
+    for (auto _ : state) {
+        bench::AllocScope alloc;
+        auto              res = T::parse(as_bytes(json), in);
+        allocs += alloc.count();
+        if (! res) {
+            state.SkipWithError(fmt::format("{}", res.error()).c_str());
+            break;
+        }
+        benchmark::DoNotOptimize(res);
+    }
+    state.SetBytesProcessed((i64)(json.size() * state.iterations()));
+    using benchmark::Counter;
+    state.counters["allocs"]   = Counter((double)allocs, Counter::kAvgIterations);
+    state.counters["json_kib"] = (double)json.size() / 1024;
+}
+
+// parse once, convert in the loop
+template<typename T, typename In, typename F>
+void BM_convert(benchmark::State& state, std::string json, F&& convert) {
+    auto res = T::parse(as_bytes(json), In {});
+    if (! res) {
+        state.SkipWithError(fmt::format("{}", res.error()).c_str());
+        return;
+    }
+    u64 allocs { 0 };
+    for (auto _ : state) {
+        bench::AllocScope alloc;
+        auto              out = convert(*res);
+        allocs += alloc.count();
+        benchmark::DoNotOptimize(out);
+    }
+    using benchmark::Counter;
+    state.counters["allocs"] = Counter((double)allocs, Counter::kAvgIterations);
+}
+
+namespace am = ncm::api_model;
+namespace qm = qcm::model;
+
+void register_all() {
+    auto reg = [](std::string_view name, auto fn, std::string json) {
+        benchmark::RegisterBenchmark(std::string(name).c_str(), fn, std::move(json))
+            ->Unit(benchmark::kMicrosecond);
+    };
+
+    auto pd = playlist_detail();
+    reg("parse/playlist_detail", BM_parse<am::PlaylistDetail, ncm::params::PlaylistDetail>, pd);
+    reg("convert/playlist_detail",
+        [](benchmark::State& s, std::string j) {
+            BM_convert<am::PlaylistDetail, ncm::params::PlaylistDetail>(
+                s, std::move(j), [](const am::PlaylistDetail& in) {
+                    qm::Playlist pl;
+                    convert(pl, in.playlist);
+                    return std::pair { pl,
+                                       convert_from<std::vector<qm::Song>>(
+                                           in.playlist.tracks.value_or(
+                                               std::vector<ncm::model::Song> {})) };
+                });
+        },
+        pd);
+
+    auto cs = cloudsearch();
+    reg("parse/cloudsearch", BM_parse<am::CloudSearch, ncm::params::CloudSearch>, cs);
+    reg("convert/cloudsearch",
+        [](benchmark::State& s, std::string j) {
+            BM_convert<am::CloudSearch, ncm::params::CloudSearch>(
+                s, std::move(j), [](const am::CloudSearch& in) {
+                    auto& r = std::get<am::CloudSearch::SongResult>(in.result);
+                    return convert_from<std::vector<qm::Song>>(
+                        r.songs.value_or(std::vector<ncm::model::Song> {}));
+                });
+        },
+        cs);
+
+    auto cm = comments();
+    reg("parse/comments", BM_parse<am::Comments, ncm::params::Comments>, cm);
+    reg("convert/comments",
+        [](benchmark::State& s, std::string j) {
+            BM_convert<am::Comments, ncm::params::Comments>(
+                s, std::move(j), [](const am::Comments& in) {
+                    return std::pair { convert_from<std::vector<qm::Comment>>(in.comments),
+                                       convert_from<std::vector<qm::Comment>>(
+                                           in.hotComments.value_or(
+                                               std::vector<ncm::model::Comment> {})) };
+                });
+        },
+        cm);
+
+    auto uc = user_cloud();
+    reg("parse/user_cloud", BM_parse<am::UserCloud, ncm::params::UserCloud>, uc);
+    reg("convert/user_cloud",
+        [](benchmark::State& s, std::string j) {
+            BM_convert<am::UserCloud, ncm::params::UserCloud>(
+                s, std::move(j), [](const am::UserCloud& in) {
+                    return convert_from<std::vector<qm::UserCloudItem>>(in.data);
+                });
+        },
+        uc);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    auto logger = qcm::LogManager::init();
+    logger->set_level(qcm::LogLevel::ERROR);
+
+    benchmark::Initialize(&argc, argv);
+    register_all();
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,225 @@
+// decode pipeline benchmark
+//
+// StreamReader -> Decoder (with Resampler) -> null sink, on sine files generated into a temp dir
+// reports x realtime, allocations per second and time to the first decoded frame
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+}
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <filesystem>
+#include <future>
+#include <numbers>
+#include <utility>
+
+#include "core/log.h"
+#include "alloc_count.h"
+
+#include "context.h"
+#include "stream_reader.h"
+#include "audio_decoder.h"
+
+using namespace player;
+
+namespace
+{
+
+constexpr i32 Seconds { 30 };
+
+struct Format {
+    std::string_view name;
+    std::string_view encoder;
+    std::string_view ext;
+};
+constexpr std::array Formats {
+    Format { "mp3", "libmp3lame", "mp3" },
+    Format { "aac", "aac", "m4a" },
+    Format { "flac", "flac", "flac" },
+};
+constexpr std::array Rates { 44100, 48000, 96000 };
+
+class NullSender : public qcm::detail::Sender<notify::info> {
+public:
+    bool              try_send(notify::info) override { return true; }
+    std::future<void> send(notify::info) override {
+        std::promise<void> p;
+        p.set_value();
+        return p.get_future();
+    }
+    void reset() override {}
+};
+
+void fill_sine(AVFrame* f, i64 offset) {
+    auto sf       = (AVSampleFormat)f->format;
+    auto packed   = av_get_packed_sample_fmt(sf);
+    bool planar   = av_sample_fmt_is_planar(sf);
+    auto channels = f->ch_layout.nb_channels;
+    for (int i = 0; i < f->nb_samples; i++) {
+        double t = (double)(offset + i) / f->sample_rate;
+        double v = 0.5 * std::sin(2 * std::numbers::pi * 440.0 * t);
+        for (int c = 0; c < channels; c++) {
+            auto  idx  = planar ? i : i * channels + c;
+            auto* data = f->extended_data[planar ? c : 0];
+            switch (packed) {
+            case AV_SAMPLE_FMT_S16: ((int16_t*)data)[idx] = (int16_t)(v * INT16_MAX); break;
+            case AV_SAMPLE_FMT_S32: ((int32_t*)data)[idx] = (int32_t)(v * INT32_MAX); break;
+            case AV_SAMPLE_FMT_FLT: ((float*)data)[idx] = (float)v; break;
+            case AV_SAMPLE_FMT_DBL: ((double*)data)[idx] = v; break;
+            default: break;
+            }
+        }
+    }
+}
+
+// stereo sine, false if the encoder is missing or rejects the rate
+bool generate(const std::filesystem::path& path, std::string_view encoder, int rate) {
+    auto codec = avcodec_find_encoder_by_name(std::string(encoder).c_str());
+    if (! codec) return false;
+
+    AVFormatContext* oc { nullptr };
+    if (avformat_alloc_output_context2(&oc, nullptr, nullptr, path.c_str()) < 0) return false;
+    AVCodecContext* c   = avcodec_alloc_context3(codec);
+    AVFrame*        f   = av_frame_alloc();
+    AVPacket*       pkt = av_packet_alloc();
+    bool            ok { false };
+
+    do {
+        AVStream* st = avformat_new_stream(oc, nullptr);
+
+        c->sample_fmt  = codec->sample_fmts ? codec->sample_fmts[0] : AV_SAMPLE_FMT_S16;
+        c->sample_rate = rate;
+        c->bit_rate    = 256000;
+        c->time_base   = av_make_q(1, rate);
+        av_channel_layout_default(&c->ch_layout, 2);
+        if (oc->oformat->flags & AVFMT_GLOBALHEADER) c->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        if (avcodec_open2(c, codec, nullptr) < 0) break;
+        if (avcodec_parameters_from_context(st->codecpar, c) < 0) break;
+        st->time_base = c->time_base;
+
+        if (avio_open(&oc->pb, path.c_str(), AVIO_FLAG_WRITE) < 0) break;
+        if (avformat_write_header(oc, nullptr) < 0) break;
+
+        f->nb_samples  = c->frame_size > 0 ? c->frame_size : 1152;
+        f->format      = c->sample_fmt;
+        f->sample_rate = rate;
+        av_channel_layout_copy(&f->ch_layout, &c->ch_layout);
+        if (av_frame_get_buffer(f, 0) < 0) break;
+
+        auto drain = [&]() {
+            while (avcodec_receive_packet(c, pkt) == 0) {
+                av_packet_rescale_ts(pkt, c->time_base, st->time_base);
+                pkt->stream_index = st->index;
+                av_interleaved_write_frame(oc, pkt);
+            }
+        };
+        for (i64 pos = 0; pos < (i64)rate * Seconds; pos += f->nb_samples) {
+            if (av_frame_make_writable(f) < 0) break;
+            fill_sine(f, pos);
+            f->pts = pos;
+            if (avcodec_send_frame(c, f) < 0) break;
+            drain();
+        }
+        avcodec_send_frame(c, nullptr);
+        drain();
+        ok = av_write_trailer(oc) == 0;
+    } while (false);
+
+    if (oc->pb) avio_closep(&oc->pb);
+    av_packet_free(&pkt);
+    av_frame_free(&f);
+    avcodec_free_context(&c);
+    avformat_free_context(oc);
+    return ok;
+}
+
+// same output as the cubeb device
+AudioParams sink_params() {
+    AudioParams p;
+    p.format      = AV_SAMPLE_FMT_S16;
+    p.sample_rate = 44100;
+    av_channel_layout_default(&p.ch_layout, 2);
+    return p;
+}
+
+void BM_decode(benchmark::State& state, std::string path) {
+    Notifier notifier { make_rc<NullSender>() };
+
+    double media_seconds { 0 };
+    double first_frame_ms { 0 };
+    u64    allocs { 0 };
+
+    for (auto _ : state) {
+        auto ctx = make_rc<Context>();
+        ctx->audio_frame_queue->set_audio_params(sink_params());
+        auto    reader = make_rc<StreamReader>(notifier);
+        Decoder dec;
+
+        bench::AllocScope alloc;
+        auto              begin = std::chrono::steady_clock::now();
+        reader->start(path, ctx->audio_pkt_queue);
+        dec.start(reader, ctx->audio_pkt_queue, ctx->audio_frame_queue);
+
+        bool first { true };
+        i64  samples { 0 };
+        for (;;) {
+            auto frame = ctx->audio_frame_queue->pop();
+            if (! frame || frame->eof()) break;
+            if (std::exchange(first, false)) {
+                first_frame_ms += std::chrono::duration<double, std::milli>(
+                                      std::chrono::steady_clock::now() - begin)
+                                      .count();
+            }
+            samples += frame->ff->nb_samples;
+            benchmark::DoNotOptimize(frame->ff->extended_data[0]);
+        }
+        allocs += alloc.count();
+        media_seconds += (double)samples / sink_params().sample_rate;
+
+        ctx->set_aborted(true);
+        reader->stop();
+        dec.stop();
+    }
+
+    using benchmark::Counter;
+    state.counters["x_realtime"]     = Counter(media_seconds, Counter::kIsRate);
+    state.counters["allocs_per_s"]   = Counter((double)allocs, Counter::kIsRate);
+    state.counters["first_frame_ms"] = Counter(first_frame_ms, Counter::kAvgIterations);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    auto logger = qcm::LogManager::init();
+    logger->set_level(qcm::LogLevel::ERROR);
+
+    benchmark::Initialize(&argc, argv);
+
+    auto dir = std::filesystem::temp_directory_path() / "qcm_bench_decode";
+    std::filesystem::create_directories(dir);
+
+    for (auto& f : Formats) {
+        for (auto rate : Rates) {
+            auto name = fmt::format("decode/{}/{}", f.name, rate);
+            auto path = dir / fmt::format("{}_{}.{}", f.name, rate, f.ext);
+            if (! generate(path, f.encoder, rate)) {
+                fmt::print(stderr, "skip {}, can't encode with {}\n", name, f.encoder);
+                continue;
+            }
+            benchmark::RegisterBenchmark(name.c_str(), BM_decode, path.native())
+                ->Unit(benchmark::kMillisecond)
+                ->UseRealTime();
+        }
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    return 0;
+}
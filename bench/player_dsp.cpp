@@ -0,0 +1,170 @@
+// output path dsp kernels, per instruction set, and the direct converter against swresample
+// on the conversions the decoder does when the rates already match
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/frame.h>
+#include <libswresample/swresample.h>
+}
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <vector>
+
+#include "core/fmt.h"
+#include "core/log.h"
+
+#include "dsp.h"
+
+using namespace player;
+
+namespace
+{
+
+// one second of stereo at 48k
+constexpr usize Frames { 48000 };
+constexpr usize Samples { Frames * 2 };
+
+std::vector<float> sine(usize n) {
+    std::vector<float> out(n);
+    for (usize i = 0; i < n; i++) out[i] = 0.8f * std::sin((float)i * 0.0577f);
+    return out;
+}
+
+void BM_f32_to_s16(benchmark::State& state, const dsp::Kernels* k) {
+    auto             in = sine(Samples);
+    std::vector<i16> out(Samples);
+    dsp::Dither      d;
+    for (auto _ : state) {
+        k->f32_to_s16(out.data(), in.data(), Samples, d);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed((i64)(Samples * state.iterations()));
+}
+
+void BM_s16_to_f32(benchmark::State& state, const dsp::Kernels* k) {
+    std::vector<i16>   in(Samples, 1234);
+    std::vector<float> out(Samples);
+    for (auto _ : state) {
+        k->s16_to_f32(out.data(), in.data(), Samples);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed((i64)(Samples * state.iterations()));
+}
+
+void BM_gain(benchmark::State& state, const dsp::Kernels* k) {
+    auto buf = sine(Samples);
+    // alternate g and 1/g, a fixed gain would decay the buffer into denormals
+    float g { 0.5f };
+    for (auto _ : state) {
+        k->gain(buf.data(), Samples, g);
+        benchmark::DoNotOptimize(buf.data());
+        g = 1.0f / g;
+    }
+    state.SetItemsProcessed((i64)(Samples * state.iterations()));
+}
+
+void BM_mono_to_stereo(benchmark::State& state, const dsp::Kernels* k) {
+    auto               in = sine(Frames);
+    std::vector<float> out(Samples);
+    for (auto _ : state) {
+        k->mono_to_stereo(out.data(), in.data(), Frames);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed((i64)(Frames * state.iterations()));
+}
+
+void BM_stereo_to_mono(benchmark::State& state, const dsp::Kernels* k) {
+    auto               in = sine(Samples);
+    std::vector<float> out(Frames);
+    for (auto _ : state) {
+        k->stereo_to_mono(out.data(), in.data(), Frames);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed((i64)(Frames * state.iterations()));
+}
+
+struct AvFrames {
+    AVFrame* in { av_frame_alloc() };
+    AVFrame* out { av_frame_alloc() };
+    ~AvFrames() {
+        av_frame_free(&in);
+        av_frame_free(&out);
+    }
+};
+
+// fltp, what the mp3 and aac decoders output, converted to s16 stereo
+void setup(AvFrames& f, int in_channels) {
+    f.in->format      = AV_SAMPLE_FMT_FLTP;
+    f.in->sample_rate = 48000;
+    f.in->nb_samples  = 1152;
+    av_channel_layout_default(&f.in->ch_layout, in_channels);
+    av_frame_get_buffer(f.in, 0);
+    for (int c = 0; c < in_channels; c++) {
+        auto p = (float*)f.in->extended_data[c];
+        for (int i = 0; i < f.in->nb_samples; i++) p[i] = 0.5f * std::sin(i * 0.05f + c);
+    }
+}
+
+void reset_out(AVFrame* out) {
+    av_frame_unref(out);
+    out->format      = AV_SAMPLE_FMT_S16;
+    out->sample_rate = 48000;
+    av_channel_layout_default(&out->ch_layout, 2);
+}
+
+void BM_convert_direct(benchmark::State& state) {
+    AvFrames f;
+    setup(f, (int)state.range(0));
+    dsp::Converter conv;
+    for (auto _ : state) {
+        reset_out(f.out);
+        conv.convert(f.out, f.in);
+        benchmark::DoNotOptimize(f.out->data[0]);
+    }
+    state.SetItemsProcessed((i64)(f.in->nb_samples * state.iterations()));
+}
+
+void BM_convert_swr(benchmark::State& state) {
+    AvFrames f;
+    setup(f, (int)state.range(0));
+    SwrContext* swr = swr_alloc();
+    reset_out(f.out);
+    swr_config_frame(swr, f.out, f.in);
+    swr_init(swr);
+    for (auto _ : state) {
+        reset_out(f.out);
+        swr_convert_frame(swr, f.out, f.in);
+        benchmark::DoNotOptimize(f.out->data[0]);
+    }
+    swr_free(&swr);
+    state.SetItemsProcessed((i64)(f.in->nb_samples * state.iterations()));
+}
+
+} // namespace
+
+BENCHMARK(BM_convert_direct)->ArgName("in_channels")->Arg(1)->Arg(2);
+BENCHMARK(BM_convert_swr)->ArgName("in_channels")->Arg(1)->Arg(2);
+
+int main(int argc, char** argv) {
+    auto logger = qcm::LogManager::init();
+    logger->set_level(qcm::LogLevel::ERROR);
+
+    benchmark::Initialize(&argc, argv);
+    for (auto isa : { dsp::Isa::Scalar, dsp::Isa::Sse2, dsp::Isa::Avx2, dsp::Isa::Neon }) {
+        auto k = dsp::kernels(isa);
+        if (! k) continue;
+        auto name = dsp::to_sv(isa);
+        benchmark::RegisterBenchmark(fmt::format("f32_to_s16/{}", name).c_str(), BM_f32_to_s16, k);
+        benchmark::RegisterBenchmark(fmt::format("s16_to_f32/{}", name).c_str(), BM_s16_to_f32, k);
+        benchmark::RegisterBenchmark(fmt::format("gain/{}", name).c_str(), BM_gain, k);
+        benchmark::RegisterBenchmark(
+            fmt::format("mono_to_stereo/{}", name).c_str(), BM_mono_to_stereo, k);
+        benchmark::RegisterBenchmark(
+            fmt::format("stereo_to_mono/{}", name).c_str(), BM_stereo_to_mono, k);
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
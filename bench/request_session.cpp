@@ -0,0 +1,194 @@
+// request::Session throughput against bench::HttpStub
+//
+//   get     small GETs, 1 or more in flight, per request overhead
+//   post    small POSTs with a request body
+//   stream  one large GET read through Response::async_read_some
+// reports allocations per request and process cpu per MiB, the stub's own share is small
+// since it writes the body straight from one buffer
+
+#include <benchmark/benchmark.h>
+
+#include <asio/as_tuple.hpp>
+#include <asio/co_spawn.hpp>
+#include <asio/thread_pool.hpp>
+#include <asio/use_awaitable.hpp>
+#include <asio/use_future.hpp>
+
+#include <ctime>
+#include <future>
+
+#include "core/log.h"
+#include "request/request.h"
+#include "request/response.h"
+#include "request/session.h"
+
+#include "alloc_count.h"
+#include "http_stub.h"
+#include "shared.h"
+
+namespace
+{
+
+constexpr usize SmallBody { 1024 };
+constexpr usize LargeBody { 64 * 1024 * 1024 };
+constexpr usize PostBody { 4 * 1024 };
+
+class Fixture {
+public:
+    Fixture()
+        : m_pool(2),
+          m_small(SmallBody),
+          m_large(LargeBody),
+          m_session(make_rc<request::Session>(m_pool.get_executor())) {}
+    ~Fixture() {
+        m_session->about_to_stop();
+        m_pool.join();
+    }
+
+    asio::thread_pool&     pool() { return m_pool; }
+    request::Session&      session() { return *m_session; }
+    const bench::HttpStub& small() const { return m_small; }
+    const bench::HttpStub& large() const { return m_large; }
+
+private:
+    asio::thread_pool    m_pool;
+    bench::HttpStub      m_small;
+    bench::HttpStub      m_large;
+    rc<request::Session> m_session;
+};
+
+double cpu_seconds() { return (double)std::clock() / CLOCKS_PER_SEC; }
+
+// body bytes, 0 on error
+asio::awaitable<usize> drain(rc<request::Response> rsp, usize buf_size) {
+    std::vector<std::byte> buf(buf_size);
+    usize                  total { 0 };
+    for (;;) {
+        auto [ec, n] = co_await rsp->async_read_some(asio::buffer(buf),
+                                                     asio::as_tuple(asio::use_awaitable));
+        total += n;
+        if (ec) co_return ec == asio::error::eof ? total : 0;
+    }
+}
+
+asio::awaitable<usize> get(request::Session& ses, std::string url, usize buf_size) {
+    request::Request req { url };
+    auto             rsp = co_await ses.get(req);
+    if (! rsp) co_return 0;
+    co_return co_await drain(*rsp, buf_size);
+}
+
+asio::awaitable<usize> post(request::Session& ses, std::string url, std::string_view body) {
+    request::Request req { url };
+    req.set_header("Content-Type", "application/octet-stream");
+    auto rsp = co_await ses.post(req, asio::buffer(body));
+    if (! rsp) co_return 0;
+    co_return co_await drain(*rsp, 4096);
+}
+
+// in_flight requests in parallel, false if any failed
+template<typename F>
+bool run_parallel(Fixture& f, usize in_flight, F&& make, u64& bytes) {
+    std::vector<std::future<usize>> futures;
+    for (usize i = 0; i < in_flight; i++) {
+        futures.push_back(asio::co_spawn(f.pool(), make(), asio::use_future));
+    }
+    bool ok { true };
+    for (auto& fu : futures) {
+        auto n = fu.get();
+        ok     = ok && n > 0;
+        bytes += n;
+    }
+    return ok;
+}
+
+void report(benchmark::State& state, u64 requests, u64 bytes, u64 allocs, double cpu) {
+    state.SetItemsProcessed((i64)requests);
+    state.SetBytesProcessed((i64)bytes);
+    state.counters["allocs_per_req"] = (double)allocs / std::max<u64>(requests, 1);
+    state.counters["cpu_ms_per_mib"] =
+        bytes ? cpu * 1000.0 / ((double)bytes / (1024 * 1024)) : 0.0;
+    state.counters["cpu_us_per_req"] = cpu * 1e6 / std::max<u64>(requests, 1);
+}
+
+void BM_get(benchmark::State& state) {
+    auto& f         = bench::Shared<Fixture>::get();
+    auto  in_flight = (usize)state.range(0);
+    auto  url       = f.small().url("small");
+
+    u64               requests { 0 }, bytes { 0 };
+    bench::AllocScope alloc;
+    auto              cpu = cpu_seconds();
+    for (auto _ : state) {
+        if (! run_parallel(
+                f, in_flight, [&] { return get(f.session(), url, 4096); }, bytes)) {
+            state.SkipWithError("request failed");
+            break;
+        }
+        requests += in_flight;
+    }
+    report(state, requests, bytes, alloc.count(), cpu_seconds() - cpu);
+}
+
+void BM_post(benchmark::State& state) {
+    auto&       f         = bench::Shared<Fixture>::get();
+    auto        in_flight = (usize)state.range(0);
+    auto        url       = f.small().url("post");
+    std::string body(PostBody, 'x');
+
+    u64               requests { 0 }, bytes { 0 };
+    bench::AllocScope alloc;
+    auto              cpu = cpu_seconds();
+    for (auto _ : state) {
+        if (! run_parallel(
+                f, in_flight, [&] { return post(f.session(), url, body); }, bytes)) {
+            state.SkipWithError("request failed");
+            break;
+        }
+        requests += in_flight;
+    }
+    report(state, requests, bytes, alloc.count(), cpu_seconds() - cpu);
+}
+
+void BM_stream(benchmark::State& state) {
+    auto& f        = bench::Shared<Fixture>::get();
+    auto  buf_size = (usize)state.range(0);
+    auto  url      = f.large().url("large");
+
+    u64               requests { 0 }, bytes { 0 };
+    bench::AllocScope alloc;
+    auto              cpu = cpu_seconds();
+    for (auto _ : state) {
+        if (! run_parallel(
+                f, 1, [&] { return get(f.session(), url, buf_size); }, bytes)) {
+            state.SkipWithError("request failed");
+            break;
+        }
+        ++requests;
+    }
+    report(state, requests, bytes, alloc.count(), cpu_seconds() - cpu);
+}
+
+} // namespace
+
+BENCHMARK(BM_get)->ArgName("in_flight")->Arg(1)->Arg(16)->UseRealTime();
+BENCHMARK(BM_post)->ArgName("in_flight")->Arg(1)->Arg(16)->UseRealTime();
+BENCHMARK(BM_stream)
+    ->ArgName("buf")
+    ->Arg(4 * 1024)
+    ->Arg(64 * 1024)
+    ->Arg(1024 * 1024)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+int main(int argc, char** argv) {
+    auto logger = qcm::LogManager::init();
+    logger->set_level(qcm::LogLevel::ERROR);
+    request::global_init();
+
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    bench::Shared<Fixture>::reset();
+    return 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "core/core.h"
+
+namespace bench
+{
+
+// one T for every benchmark in the binary, created by the first one to use it
+// call reset() in main after RunSpecifiedBenchmarks, while the logger is still alive
+template<typename T>
+class Shared {
+public:
+    static T& get() {
+        auto& p = instance();
+        if (! p) p = make_up<T>();
+        return *p;
+    }
+    static void reset() { instance().reset(); }
+
+private:
+    static up<T>& instance() {
+        static up<T> p;
+        return p;
+    }
+};
+
+} // namespace bench
@@ -1,6 +1,7 @@
 #pragma once
 #include <string_view>
 #include <source_location>
+#include <memory>
 
 #include "core/fmt.h"
 
@@ -17,6 +18,16 @@ enum class LogLevel
     ERROR,
 };
 
+// levels below are compiled out, set by the build
+#ifndef QCM_LOG_MIN_LEVEL
+#    ifdef NDEBUG
+#        define QCM_LOG_MIN_LEVEL 1
+#    else
+#        define QCM_LOG_MIN_LEVEL 0
+#    endif
+#endif
+inline constexpr LogLevel min_level { QCM_LOG_MIN_LEVEL };
+
 constexpr const char* past_last_slash(const char* const path, const int pos = 0,
                                       const int last_slash = 0) {
     if (path[pos] == '\0') return path + last_slash;
@@ -46,16 +57,33 @@ public:
     void log(LogLevel level, const std::source_location loc, fmt::format_string<T...> fmt,
              T&&... args) {
         if (level < m_level) return;
-        log_loc_raw(level, loc, fmt::vformat(fmt, fmt::make_format_args(args...)));
+        // inline buffer, no allocation for short messages
+        fmt::memory_buffer buf;
+        fmt::vformat_to(std::back_inserter(buf), fmt, fmt::make_format_args(args...));
+        log_loc_raw(level, loc, std::string_view { buf.data(), buf.size() });
     }
 
     void log_loc_raw(LogLevel level, const std::source_location loc, std::string_view);
     void log_raw(LogLevel level, std::string_view);
 
     void set_level(LogLevel);
+    bool enabled(LogLevel level) const { return level >= m_level; }
+
+    // hand records to a background flusher through per thread rings
+    // callers never touch stdio, a full ring drops the record
+    void start_async();
+    // also write to file, rotate to path.1 .. path.max_files at max_size bytes
+    bool set_file_sink(std::string_view path, std::size_t max_size, std::size_t max_files);
+    // also write compact binary records, see core/log_record.h
+    bool set_binary_sink(std::string_view path);
+    // write out pending records on the calling thread
+    void flush();
+
+    class Async;
 
 private:
-    LogLevel m_level;
+    LogLevel               m_level;
+    std::unique_ptr<Async> m_async;
 };
 
 inline constexpr void             noop() {}
@@ -63,6 +91,7 @@ inline constexpr std::string_view noop_str() { return {}; }
 
 [[noreturn]] inline void fail(std::string_view msg) {
     LogManager::instance()->log_raw(LogLevel::ERROR, msg);
+    LogManager::instance()->flush();
 
     // Crash with access violation and generate crash report.
     volatile auto nullptr_value = (int*)nullptr;
@@ -105,7 +134,12 @@ using LogManager = log::LogManager;
 } // namespace qcm
 
 // clang-format off
-#define GENERIC_LOG(lv, ...) qcm::LogManager::instance()->log(lv, std::source_location::current(), __VA_ARGS__);
+// arguments are only evaluated when the level is enabled
+#define GENERIC_LOG(lv, ...)                                                          \
+    if constexpr (lv >= qcm::log::min_level) {                                        \
+        if (auto lm_ = qcm::LogManager::instance(); lm_->enabled(lv))                 \
+            lm_->log(lv, std::source_location::current(), __VA_ARGS__);              \
+    }
 
 #define ERROR_LOG(...)   do { GENERIC_LOG(qcm::LogLevel::ERROR,   __VA_ARGS__) } while (false)
 #define WARN_LOG(...)    do { GENERIC_LOG(qcm::LogLevel::WARN, __VA_ARGS__) } while (false)
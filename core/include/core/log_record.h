@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+// binary log format, shared by the async log sink and the decoder tool
+//
+// file:   Magic, then a stream of entries
+// entry:  u8 tag, then fields, integers are unsigned leb128
+//   String  id, len, bytes                 define id for a source string
+//   Thread  id, native                     define a logging thread
+//   Record  level, thread, ts_delta, file, func, line, len, bytes
+//
+// ts_delta is nanoseconds since the previous record on a monotonic clock
+// string id 0 is the empty string
+
+namespace qcm::log::binary
+{
+
+inline constexpr std::string_view Magic { "QCMLOG\0\1", 8 };
+
+enum class Tag : std::uint8_t
+{
+    String = 1,
+    Thread = 2,
+    Record = 3,
+};
+
+inline void put_varint(std::string& out, std::uint64_t v) {
+    do {
+        std::uint8_t b = v & 0x7f;
+        v >>= 7;
+        if (v) b |= 0x80;
+        out.push_back((char)b);
+    } while (v);
+}
+
+inline void put_bytes(std::string& out, std::string_view s) {
+    put_varint(out, s.size());
+    out.append(s);
+}
+
+class Reader {
+public:
+    Reader(std::span<const char> data): m_data(data), m_pos(0) {}
+
+    bool eof() const { return m_pos >= m_data.size(); }
+
+    std::optional<std::uint8_t> u8() {
+        if (eof()) return std::nullopt;
+        return (std::uint8_t)m_data[m_pos++];
+    }
+
+    std::optional<std::uint64_t> varint() {
+        std::uint64_t v { 0 };
+        for (int shift = 0; shift < 64; shift += 7) {
+            auto b = u8();
+            if (! b) return std::nullopt;
+            v |= (std::uint64_t)(*b & 0x7f) << shift;
+            if (! (*b & 0x80)) return v;
+        }
+        return std::nullopt;
+    }
+
+    std::optional<std::string_view> bytes() {
+        auto len = varint();
+        if (! len || *len > m_data.size() - m_pos) return std::nullopt;
+        std::string_view out { m_data.data() + m_pos, (std::size_t)*len };
+        m_pos += *len;
+        return out;
+    }
+
+private:
+    std::span<const char> m_data;
+    std::size_t           m_pos;
+};
+
+} // namespace qcm::log::binary
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// process wide metrics, rendered in prometheus text format
+//
+// metrics are registered once by name and never removed, keep the returned reference
+// and update it lock free, e.g.
+//   static auto& hits = metrics::counter("qcm_x_total{kind=\"a\"}", "help");
+// labels are part of the name, metrics with the same base name form one family
+
+namespace qcm::metrics
+{
+
+class Counter {
+public:
+    void          inc(std::uint64_t n = 1) { m_v.fetch_add(n, std::memory_order_relaxed); }
+    std::uint64_t value() const { return m_v.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<std::uint64_t> m_v { 0 };
+};
+
+class Gauge {
+public:
+    void         set(std::int64_t v) { m_v.store(v, std::memory_order_relaxed); }
+    void         add(std::int64_t n) { m_v.fetch_add(n, std::memory_order_relaxed); }
+    std::int64_t value() const { return m_v.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<std::int64_t> m_v { 0 };
+};
+
+// log linear buckets like hdr histogram, 4 sub buckets per power of two,
+// about 20% relative error from 1us to ~9h
+// records microseconds, rendered as seconds
+class Histogram {
+public:
+    static constexpr unsigned      SubBits    = 2;
+    static constexpr unsigned      SubBuckets = 1 << SubBits;
+    static constexpr unsigned      MaxBits    = 35;
+    static constexpr std::size_t   Buckets    = SubBuckets * (MaxBits - SubBits + 1);
+    static constexpr std::uint64_t MaxValue   = (std::uint64_t(1) << MaxBits) - 1;
+
+    void observe(std::uint64_t us);
+    template<typename Rep, typename Period>
+    void observe(std::chrono::duration<Rep, Period> d) {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+        observe(us > 0 ? (std::uint64_t)us : 0);
+    }
+
+    static std::size_t   bucket(std::uint64_t v);
+    // largest value in bucket
+    static std::uint64_t bucket_max(std::size_t idx);
+
+    std::uint64_t count(std::size_t idx) const {
+        return m_buckets[idx].load(std::memory_order_relaxed);
+    }
+    std::uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+    std::uint64_t sum() const { return m_sum.load(std::memory_order_relaxed); }
+    // upper bound of the bucket holding the q quantile, 0 when empty
+    std::uint64_t quantile(double q) const;
+
+private:
+    std::array<std::atomic<std::uint64_t>, Buckets> m_buckets {};
+    std::atomic<std::uint64_t>                      m_count { 0 };
+    std::atomic<std::uint64_t>                      m_sum { 0 };
+};
+
+// find or register
+Counter&   counter(std::string_view name, std::string_view help);
+Gauge&     gauge(std::string_view name, std::string_view help);
+Histogram& histogram(std::string_view name, std::string_view help);
+
+std::string render();
+
+} // namespace qcm::metrics
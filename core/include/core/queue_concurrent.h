@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
 #include <optional>
@@ -11,6 +12,7 @@
 #include <cmath>
 
 #include "core/core.h"
+#include "core/metrics.h"
 
 namespace qcm
 {
@@ -40,13 +42,18 @@ public:
 
     template<typename... TArg>
     QueueConcurrent(TArg... args)
-        : m_data(make_up<Data>()), m_temp_push(true), m_queue(std::forward<TArg>(args)...) {}
+        : m_data(make_up<Data>()),
+          m_temp_push(true),
+          m_queue(std::forward<TArg>(args)...),
+          m_depth(nullptr) {}
     ~QueueConcurrent() {}
 
     QueueConcurrent(Self&& o) { *this = std::move(o); }
     Self& operator=(Self&& o) {
         m_data  = std::exchange(o.m_data, nullptr);
         m_queue = std::move(o.m_queue);
+        m_depth = std::exchange(o.m_depth, nullptr);
+        m_size.store(o.m_size.load(std::memory_order_relaxed), std::memory_order_relaxed);
         return *this;
     }
 
@@ -61,6 +68,7 @@ public:
         }
         m_temp_push = true;
         auto ret    = m_queue.push(std::forward<T>(v));
+        update_depth();
         notify_add(v.size());
         return ret;
     }
@@ -71,6 +79,7 @@ public:
             m_data->not_empty.wait(lock);
         }
         auto ret = m_queue.pop();
+        update_depth();
         if (queue().is_notify_pop()) notify_remove(1);
         return ret;
     }
@@ -81,6 +90,7 @@ public:
             m_data->not_empty.wait(lock);
         }
         auto ret = m_queue.pop(num);
+        update_depth();
         if (queue().is_notify_pop()) notify_remove(num);
         return ret;
     }
@@ -88,12 +98,14 @@ public:
     auto try_push(value_type&& v) {
         lock_type lock { m_data->mutex };
         auto      ret = m_queue.push(std::array { std::move(v) });
+        update_depth();
         notify_add(1);
         return ret;
     }
     auto try_pop() {
         lock_type lock { m_data->mutex };
         auto      ret = m_queue.pop();
+        update_depth();
         if (queue().is_notify_pop()) notify_remove(1);
         return ret;
     }
@@ -101,13 +113,23 @@ public:
     void clear() {
         lock_type lock { m_data->mutex };
         queue().clear();
+        update_depth();
         clear_wait();
     }
 
+    // mirror size into a gauge, must outlive the queue
+    void set_depth_gauge(metrics::Gauge* g) {
+        lock_type lock { m_data->mutex };
+        m_depth = g;
+        update_depth();
+    }
+
     usize size() {
         lock_type lock { m_data->mutex };
         return queue().size();
     }
+    // no lock, may lag behind a concurrent push or pop, for realtime threads
+    usize approx_size() const { return m_size.load(std::memory_order_relaxed); }
 
     void wake_one_pusher() {
         lock_type lock { m_data->mutex };
@@ -123,6 +145,11 @@ protected:
         for (i32 i = 0; i < n; i++) m_data->not_full.notify_one();
     }
 
+    void update_depth() {
+        m_size.store(m_queue.size(), std::memory_order_relaxed);
+        if (m_depth) m_depth->set(m_queue.size());
+    }
+
     void clear_wait() {
         m_data->not_empty.notify_all();
         m_data->not_full.notify_all();
@@ -143,9 +170,11 @@ private:
         condition_type not_empty;
         condition_type not_full;
     };
-    bool     m_temp_push;
-    up<Data> m_data;
-    Queue    m_queue;
+    bool               m_temp_push;
+    up<Data>           m_data;
+    Queue              m_queue;
+    metrics::Gauge*    m_depth;
+    std::atomic<usize> m_size { 0 };
 };
 
 template<typename V>
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// lightweight tracing, exported as chrome trace json (chrome://tracing, ui.perfetto.dev)
+//
+// spans are recorded into per thread buffers only while tracing is started,
+// otherwise a span is a relaxed atomic load
+
+namespace qcm::trace
+{
+
+namespace detail
+{
+extern std::atomic<bool> active;
+} // namespace detail
+
+inline bool enabled() { return detail::active.load(std::memory_order_relaxed); }
+
+// steady clock, nanoseconds
+std::int64_t now();
+
+void start();
+// stop collecting and write all recorded events
+bool stop(std::string_view path);
+
+// name and cat must outlive the trace, use string literals
+void complete(const char* name, const char* cat, std::int64_t begin, std::int64_t end,
+              std::uint32_t tid, std::string detail = {});
+void instant(const char* name, const char* cat, std::string detail = {});
+
+// id of the calling thread in the trace
+std::uint32_t thread_id();
+
+class Span {
+public:
+    Span(const char* name, const char* cat)
+        : m_name(name), m_cat(cat), m_begin(enabled() ? now() : -1), m_tid(0) {
+        if (m_begin >= 0) m_tid = thread_id();
+    }
+    ~Span() { end(); }
+    Span(const Span&)            = delete;
+    Span& operator=(const Span&) = delete;
+
+    explicit operator bool() const { return m_begin >= 0; }
+
+    // shown as args.detail
+    void set_detail(std::string_view v) {
+        if (m_begin >= 0) m_detail = v;
+    }
+
+    // a span may end on another thread, e.g. across co_await, it stays on the starting one
+    void end() {
+        if (m_begin < 0) return;
+        complete(m_name, m_cat, m_begin, now(), m_tid, std::move(m_detail));
+        m_begin = -1;
+    }
+
+private:
+    const char*   m_name;
+    const char*   m_cat;
+    std::int64_t  m_begin;
+    std::uint32_t m_tid;
+    std::string   m_detail;
+};
+
+} // namespace qcm::trace
+
+#define QCM_TRACE_CONCAT_(a, b) a##b
+#define QCM_TRACE_CONCAT(a, b)  QCM_TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name, cat)  qcm::trace::Span QCM_TRACE_CONCAT(trace_span_, __LINE__)(name, cat)
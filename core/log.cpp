@@ -1,10 +1,21 @@
 #include "core/core.h"
 #include "core/log.h"
+#include "core/log_record.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 using namespace qcm;
+namespace binary = qcm::log::binary;
 
 namespace
 {
@@ -33,8 +44,311 @@ bool check_stderr(qcm::LogLevel lv) {
     }
 }
 
+constexpr usize RingSize { 256 };
+constexpr usize SlotText { 224 };
+constexpr auto  IdleWait = std::chrono::milliseconds(5);
+
+i64 now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+struct Record {
+    LogLevel    level;
+    bool        has_loc;
+    u32         line;
+    u32         column;
+    const char* file;
+    const char* func;
+    u32         thread;
+    i64         timestamp;
+    u32         size;
+    char        text[SlotText];
+    // text longer than the slot
+    up<std::string> overflow;
+
+    std::string_view content() const {
+        return overflow ? std::string_view { *overflow } : std::string_view { text, size };
+    }
+};
+
+// single producer (owner thread), single consumer (drain, under the drain mutex)
+struct Ring : NoCopy {
+    Ring(u32 id): id(id), native(std::hash<std::thread::id> {}(std::this_thread::get_id())) {}
+
+    u32                          id;
+    u64                          native;
+    std::array<Record, RingSize> slots;
+    std::atomic<usize>           head { 0 };
+    std::atomic<usize>           tail { 0 };
+    std::atomic<bool>            dead { false };
+
+    template<typename F>
+    bool push(F&& fill) {
+        auto h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= RingSize) return false;
+        fill(slots[h % RingSize]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    template<typename F>
+    usize pop_all(F&& f) {
+        auto t = tail.load(std::memory_order_relaxed);
+        auto h = head.load(std::memory_order_acquire);
+        for (auto i = t; i < h; i++) {
+            f(slots[i % RingSize]);
+        }
+        tail.store(h, std::memory_order_release);
+        return h - t;
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+};
+
+void format_record(fmt::memory_buffer& buf, const Record& r) {
+    if (r.has_loc) {
+        fmt::format_to(std::back_inserter(buf),
+                       "{} {} at {}({}:{})\n",
+                       to_sv(r.level),
+                       r.content(),
+                       r.file,
+                       r.line,
+                       r.column);
+    } else {
+        fmt::format_to(std::back_inserter(buf), "{}", r.content());
+    }
+}
+
 } // namespace
 
+class LogManager::Async : NoCopy {
+public:
+    Async(): m_dropped(0), m_stop(false) {
+        m_thread = std::thread([this]() {
+            run();
+        });
+    }
+    ~Async() {
+        m_stop = true;
+        m_thread.join();
+        drain();
+        if (m_file) std::fclose(m_file);
+        if (m_bin) std::fclose(m_bin);
+    }
+
+    void push(LogLevel level, const std::source_location* loc, std::string_view content) {
+        auto& ring = local();
+        auto  ok   = ring.push([&](Record& r) {
+            r.level     = level;
+            r.has_loc   = loc != nullptr;
+            r.line      = loc ? loc->line() : 0;
+            r.column    = loc ? loc->column() : 0;
+            r.file      = loc ? loc->file_name() : nullptr;
+            r.func      = loc ? loc->function_name() : nullptr;
+            r.thread    = ring.id;
+            r.timestamp = now_ns();
+            r.size      = std::min(content.size(), SlotText);
+            std::copy_n(content.data(), r.size, r.text);
+            if (content.size() > SlotText)
+                r.overflow = std::make_unique<std::string>(content);
+            else
+                r.overflow.reset();
+        });
+        if (! ok) m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool set_file(std::string_view path, usize max_size, usize max_files) {
+        std::lock_guard lock { m_drain_mutex };
+        if (m_file) std::fclose(m_file);
+        m_file_path = path;
+        m_max_size  = max_size;
+        m_max_files = max_files;
+        m_file      = std::fopen(m_file_path.c_str(), "a");
+        std::error_code ec;
+        auto            size = std::filesystem::file_size(m_file_path, ec);
+        m_file_size          = ec ? 0 : size;
+        return m_file != nullptr;
+    }
+
+    bool set_binary(std::string_view path) {
+        std::lock_guard lock { m_drain_mutex };
+        if (m_bin) std::fclose(m_bin);
+        m_bin = std::fopen(std::string(path).c_str(), "wb");
+        m_str_ids.clear();
+        m_bin_threads.clear();
+        m_bin_ts = 0;
+        if (! m_bin) return false;
+        std::fwrite(binary::Magic.data(), 1, binary::Magic.size(), m_bin);
+        return true;
+    }
+
+    usize drain() {
+        std::lock_guard lock { m_drain_mutex };
+
+        std::vector<rc<Ring>> rings;
+        {
+            std::lock_guard lock { m_rings_mutex };
+            // rings of exited threads are dropped once empty
+            std::erase_if(m_rings, [](auto& r) {
+                return r->dead && r->empty();
+            });
+            rings = m_rings;
+        }
+
+        m_batch.clear();
+        for (auto& r : rings) {
+            r->pop_all([this](Record& rec) {
+                m_batch.emplace_back(std::move(rec));
+            });
+        }
+        // rings are drained one by one, restore time order
+        std::stable_sort(m_batch.begin(), m_batch.end(), [](auto& a, auto& b) {
+            return a.timestamp < b.timestamp;
+        });
+
+        bool               out_used { false }, err_used { false };
+        fmt::memory_buffer buf;
+        for (auto& rec : m_batch) {
+            buf.clear();
+            format_record(buf, rec);
+            auto to_err = check_stderr(rec.level);
+            std::fwrite(buf.data(), 1, buf.size(), to_err ? stderr : stdout);
+            (to_err ? err_used : out_used) = true;
+            write_file(buf);
+            write_binary(rec);
+        }
+        if (auto dropped = m_dropped.exchange(0, std::memory_order_relaxed)) {
+            fmt::print(stderr, "WARN log ring full, dropped {} records\n", dropped);
+            err_used = true;
+        }
+        if (out_used) std::fflush(stdout);
+        if (err_used) std::fflush(stderr);
+        if (m_file) std::fflush(m_file);
+        if (m_bin) std::fflush(m_bin);
+        return m_batch.size();
+    }
+
+private:
+    struct Holder {
+        rc<Ring> ring;
+        ~Holder() {
+            if (ring) ring->dead = true;
+        }
+    };
+
+    Ring& local() {
+        thread_local Holder holder;
+        if (! holder.ring) {
+            std::lock_guard lock { m_rings_mutex };
+            holder.ring = std::make_shared<Ring>(m_next_thread++);
+            m_rings.push_back(holder.ring);
+        }
+        return *holder.ring;
+    }
+
+    void run() {
+        while (! m_stop) {
+            if (drain() == 0) std::this_thread::sleep_for(IdleWait);
+        }
+    }
+
+    void write_file(const fmt::memory_buffer& buf) {
+        if (! m_file) return;
+        m_file_size += std::fwrite(buf.data(), 1, buf.size(), m_file);
+        if (m_max_size > 0 && m_file_size >= m_max_size) rotate();
+    }
+
+    u64 string_id(const char* s) {
+        if (s == nullptr || *s == '\0') return 0;
+        auto [it, inserted] = m_str_ids.try_emplace(s, m_str_ids.size() + 1);
+        if (inserted) {
+            m_bin_buf.push_back((char)binary::Tag::String);
+            binary::put_varint(m_bin_buf, it->second);
+            binary::put_bytes(m_bin_buf, s);
+        }
+        return it->second;
+    }
+
+    void write_binary(const Record& rec) {
+        if (! m_bin) return;
+        m_bin_buf.clear();
+        if (! m_bin_threads.contains(rec.thread)) {
+            u64 native { 0 };
+            {
+                std::lock_guard lock { m_rings_mutex };
+                for (auto& r : m_rings) {
+                    if (r->id == rec.thread) native = r->native;
+                }
+            }
+            m_bin_threads.insert({ rec.thread, native });
+            m_bin_buf.push_back((char)binary::Tag::Thread);
+            binary::put_varint(m_bin_buf, rec.thread);
+            binary::put_varint(m_bin_buf, native);
+        }
+        auto file = string_id(rec.file);
+        auto func = string_id(rec.func);
+
+        m_bin_buf.push_back((char)binary::Tag::Record);
+        m_bin_buf.push_back((char)rec.level);
+        binary::put_varint(m_bin_buf, rec.thread);
+        binary::put_varint(m_bin_buf, (u64)std::max<i64>(rec.timestamp - m_bin_ts, 0));
+        binary::put_varint(m_bin_buf, file);
+        binary::put_varint(m_bin_buf, func);
+        binary::put_varint(m_bin_buf, rec.line);
+        binary::put_bytes(m_bin_buf, rec.content());
+        m_bin_ts = std::max(m_bin_ts, rec.timestamp);
+
+        std::fwrite(m_bin_buf.data(), 1, m_bin_buf.size(), m_bin);
+    }
+
+    void rotate() {
+        std::fclose(m_file);
+        std::error_code ec;
+        namespace fs = std::filesystem;
+        auto name    = [this](usize i) {
+            return fs::path(fmt::format("{}.{}", m_file_path, i));
+        };
+        if (m_max_files > 0) {
+            fs::remove(name(m_max_files), ec);
+            for (auto i = m_max_files; i > 1; i--) {
+                fs::rename(name(i - 1), name(i), ec);
+            }
+            fs::rename(m_file_path, name(1), ec);
+        } else {
+            fs::remove(m_file_path, ec);
+        }
+        m_file      = std::fopen(m_file_path.c_str(), "w");
+        m_file_size = 0;
+    }
+
+    std::mutex            m_rings_mutex;
+    std::vector<rc<Ring>> m_rings;
+    u32                   m_next_thread { 1 };
+
+    std::mutex          m_drain_mutex;
+    std::vector<Record> m_batch;
+    std::atomic<u64>    m_dropped;
+
+    FILE*       m_file { nullptr };
+    std::string m_file_path;
+    usize       m_file_size { 0 };
+    usize       m_max_size { 0 };
+    usize       m_max_files { 0 };
+
+    FILE*                                m_bin { nullptr };
+    std::string                          m_bin_buf;
+    std::unordered_map<const char*, u64> m_str_ids;
+    std::unordered_map<u32, u64>         m_bin_threads;
+    i64                                  m_bin_ts { 0 };
+
+    std::atomic<bool> m_stop;
+    std::thread       m_thread;
+};
+
 static up<LogManager> log_manager;
 
 LogManager* LogManager::init() {
@@ -49,7 +363,31 @@ LogManager::~LogManager() {}
 
 void LogManager::set_level(LogLevel l) { m_level = l; }
 
+void LogManager::start_async() {
+    if (! m_async) m_async = std::make_unique<Async>();
+}
+
+bool LogManager::set_file_sink(std::string_view path, std::size_t max_size,
+                               std::size_t max_files) {
+    start_async();
+    return m_async->set_file(path, max_size, max_files);
+}
+
+bool LogManager::set_binary_sink(std::string_view path) {
+    start_async();
+    return m_async->set_binary(path);
+}
+
+void LogManager::flush() {
+    if (m_async) m_async->drain();
+}
+
 void LogManager::log_raw(LogLevel level, std::string_view content) {
+    if (m_async) {
+        m_async->push(level, nullptr, content);
+        return;
+    }
+
     FILE* out = nullptr;
     switch (level) {
         using enum LogLevel;
@@ -63,6 +401,11 @@ void LogManager::log_raw(LogLevel level, std::string_view content) {
 };
 void LogManager::log_loc_raw(LogLevel level, const std::source_location loc,
                              std::string_view content) {
+    if (m_async) {
+        m_async->push(level, &loc, content);
+        return;
+    }
+
     log_raw(level,
             fmt::format("{} {} at {}({}:{})\n",
                         to_sv(level),
@@ -81,4 +424,4 @@ std::string log::format_assert(std::string_view expr_str, const std::source_loca
                        expr_str,
                        msg.empty() ? "" : "\n",
                        msg);
-}
\ No newline at end of file
+}
@@ -0,0 +1,191 @@
+#include "core/metrics.h"
+#include "core/core.h"
+#include "core/log.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <map>
+#include <mutex>
+
+using namespace qcm;
+using namespace qcm::metrics;
+
+namespace
+{
+
+enum class Kind
+{
+    Counter,
+    Gauge,
+    Histogram,
+};
+
+std::string_view to_sv(Kind k) {
+    switch (k) {
+    case Kind::Counter: return "counter";
+    case Kind::Gauge: return "gauge";
+    case Kind::Histogram: return "histogram";
+    }
+    return "untyped";
+}
+
+struct Metric {
+    up<Counter>   counter;
+    up<Gauge>     gauge;
+    up<Histogram> histogram;
+};
+
+struct Family {
+    Kind        kind;
+    std::string help;
+    // keyed by labels, without braces
+    std::map<std::string, Metric, std::less<>> metrics;
+};
+
+struct Registry {
+    std::mutex                                 mutex;
+    std::map<std::string, Family, std::less<>> families;
+};
+
+Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+Metric& find_or_add(std::string_view name, std::string_view help, Kind kind) {
+    std::string_view base { name }, labels;
+    if (auto pos = name.find('{'); pos != std::string_view::npos) {
+        base   = name.substr(0, pos);
+        labels = name.substr(pos + 1);
+        if (labels.ends_with('}')) labels.remove_suffix(1);
+    }
+
+    auto&           r = registry();
+    std::lock_guard lock { r.mutex };
+
+    auto it = r.families.find(base);
+    if (it == r.families.end()) {
+        it = r.families.emplace(std::string(base), Family { kind, std::string(help), {} }).first;
+    }
+    auto& fam = it->second;
+    _assert_msg_rel_(fam.kind == kind, "metric {} registered as {}", base, to_sv(fam.kind));
+
+    auto m_it = fam.metrics.find(labels);
+    if (m_it == fam.metrics.end()) {
+        m_it    = fam.metrics.emplace(std::string(labels), Metric {}).first;
+        auto& m = m_it->second;
+        switch (kind) {
+        case Kind::Counter: m.counter = make_up<Counter>(); break;
+        case Kind::Gauge: m.gauge = make_up<Gauge>(); break;
+        case Kind::Histogram: m.histogram = make_up<Histogram>(); break;
+        }
+    }
+    return m_it->second;
+}
+
+std::string join_labels(std::string_view labels, std::string_view extra) {
+    if (labels.empty() && extra.empty()) return {};
+    if (labels.empty()) return fmt::format("{{{}}}", extra);
+    if (extra.empty()) return fmt::format("{{{}}}", labels);
+    return fmt::format("{{{},{}}}", labels, extra);
+}
+
+} // namespace
+
+std::size_t Histogram::bucket(std::uint64_t v) {
+    v = std::min(v, MaxValue);
+    if (v < SubBuckets) return v;
+    unsigned msb   = std::bit_width(v) - 1;
+    unsigned shift = msb - SubBits;
+    return SubBuckets + shift * SubBuckets + ((v >> shift) - SubBuckets);
+}
+
+std::uint64_t Histogram::bucket_max(std::size_t idx) {
+    if (idx < SubBuckets) return idx;
+    unsigned shift = (idx - SubBuckets) / SubBuckets;
+    u64      sub   = (idx - SubBuckets) % SubBuckets;
+    return ((SubBuckets + sub + 1) << shift) - 1;
+}
+
+void Histogram::observe(std::uint64_t us) {
+    m_buckets[bucket(us)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(us, std::memory_order_relaxed);
+}
+
+std::uint64_t Histogram::quantile(double q) const {
+    std::array<u64, Buckets> counts;
+    u64                      total { 0 };
+    for (usize i = 0; i < Buckets; i++) {
+        counts[i] = count(i);
+        total += counts[i];
+    }
+    if (total == 0) return 0;
+
+    auto rank = std::max<u64>((u64)std::ceil(std::clamp(q, 0.0, 1.0) * total), 1);
+    u64  seen { 0 };
+    for (usize i = 0; i < Buckets; i++) {
+        seen += counts[i];
+        if (seen >= rank) return bucket_max(i);
+    }
+    return bucket_max(Buckets - 1);
+}
+
+Counter& metrics::counter(std::string_view name, std::string_view help) {
+    return *find_or_add(name, help, Kind::Counter).counter;
+}
+Gauge& metrics::gauge(std::string_view name, std::string_view help) {
+    return *find_or_add(name, help, Kind::Gauge).gauge;
+}
+Histogram& metrics::histogram(std::string_view name, std::string_view help) {
+    return *find_or_add(name, help, Kind::Histogram).histogram;
+}
+
+std::string metrics::render() {
+    auto&       r = registry();
+    std::string out;
+    auto        it = std::back_inserter(out);
+
+    std::lock_guard lock { r.mutex };
+    for (auto& [name, fam] : r.families) {
+        fmt::format_to(it, "# HELP {} {}\n# TYPE {} {}\n", name, fam.help, name, to_sv(fam.kind));
+        for (auto& [labels, m] : fam.metrics) {
+            switch (fam.kind) {
+            case Kind::Counter:
+                fmt::format_to(
+                    it, "{}{} {}\n", name, join_labels(labels, {}), m.counter->value());
+                break;
+            case Kind::Gauge:
+                fmt::format_to(it, "{}{} {}\n", name, join_labels(labels, {}), m.gauge->value());
+                break;
+            case Kind::Histogram: {
+                auto& h = *m.histogram;
+                // snapshot first, so +Inf and _count match the buckets
+                std::array<u64, Histogram::Buckets> counts;
+                for (usize i = 0; i < Histogram::Buckets; i++) counts[i] = h.count(i);
+                // always the full bucket set, so the le series stay the same between scrapes
+                u64 count { 0 };
+                for (usize i = 0; i < Histogram::Buckets; i++) {
+                    count += counts[i];
+                    auto le = fmt::format("le=\"{}\"", Histogram::bucket_max(i) / 1e6);
+                    fmt::format_to(it, "{}_bucket{} {}\n", name, join_labels(labels, le), count);
+                }
+                fmt::format_to(it,
+                               "{}_bucket{} {}\n{}_sum{} {}\n{}_count{} {}\n",
+                               name,
+                               join_labels(labels, "le=\"+Inf\""),
+                               count,
+                               name,
+                               join_labels(labels, {}),
+                               h.sum() / 1e6,
+                               name,
+                               join_labels(labels, {}),
+                               count);
+                break;
+            }
+            }
+        }
+    }
+    return out;
+}
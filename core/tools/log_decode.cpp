@@ -0,0 +1,110 @@
+// decode a binary log written by LogManager::set_binary_sink
+//
+// usage: qcm_log_decode <file>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "core/log.h"
+#include "core/log_record.h"
+
+namespace binary = qcm::log::binary;
+
+namespace
+{
+std::string_view level_name(std::uint8_t lv) {
+    switch ((qcm::LogLevel)lv) {
+    case qcm::LogLevel::DEBUG: return "DEBUG";
+    case qcm::LogLevel::INFO: return "INFO";
+    case qcm::LogLevel::WARN: return "WARN";
+    case qcm::LogLevel::ERROR: return "ERROR";
+    }
+    return "?";
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        fmt::print(stderr, "usage: {} <file>\n", argv[0]);
+        return 2;
+    }
+
+    std::ifstream     in(argv[1], std::ios::binary);
+    std::vector<char> data { std::istreambuf_iterator<char>(in), {} };
+    if (! in.good() && ! in.eof()) {
+        fmt::print(stderr, "can't read {}\n", argv[1]);
+        return 1;
+    }
+    if (data.size() < binary::Magic.size() ||
+        std::string_view(data.data(), binary::Magic.size()) != binary::Magic) {
+        fmt::print(stderr, "not a qcm binary log\n");
+        return 1;
+    }
+
+    binary::Reader reader { std::span<const char>(data).subspan(binary::Magic.size()) };
+
+    std::unordered_map<std::uint64_t, std::string_view> strings { { 0, "" } };
+    std::unordered_map<std::uint64_t, std::uint64_t>    threads;
+    std::uint64_t                                       ts { 0 };
+    std::uint64_t                                       count { 0 };
+
+    auto str = [&strings](std::uint64_t id) -> std::string_view {
+        auto it = strings.find(id);
+        return it != strings.end() ? it->second : "?";
+    };
+
+    while (! reader.eof()) {
+        auto tag = reader.u8();
+        bool ok  = false;
+        switch ((binary::Tag)*tag) {
+        case binary::Tag::String: {
+            auto id = reader.varint();
+            auto s  = reader.bytes();
+            if ((ok = id && s)) strings[*id] = *s;
+            break;
+        }
+        case binary::Tag::Thread: {
+            auto id     = reader.varint();
+            auto native = reader.varint();
+            if ((ok = id && native)) threads[*id] = *native;
+            break;
+        }
+        case binary::Tag::Record: {
+            auto level  = reader.u8();
+            auto thread = reader.varint();
+            auto delta  = reader.varint();
+            auto file   = reader.varint();
+            auto func   = reader.varint();
+            auto line   = reader.varint();
+            auto msg    = reader.bytes();
+            ok          = level && thread && delta && file && func && line && msg;
+            if (! ok) break;
+
+            ts += *delta;
+            ++count;
+            fmt::print("{}.{:09} [{:x}] {} {} at {}:{} ({})\n",
+                       ts / 1000000000,
+                       ts % 1000000000,
+                       threads.contains(*thread) ? threads[*thread] : *thread,
+                       level_name(*level),
+                       *msg,
+                       str(*file),
+                       *line,
+                       str(*func));
+            break;
+        }
+        default: break;
+        }
+        if (! ok) {
+            fmt::print(stderr, "truncated or corrupt log after {} records\n", count);
+            return 1;
+        }
+    }
+    return 0;
+}
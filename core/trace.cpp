@@ -0,0 +1,207 @@
+#include "core/trace.h"
+#include "core/core.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#ifdef __linux__
+extern "C" {
+#    include <pthread.h>
+}
+#endif
+
+#include <fmt/format.h>
+
+using namespace qcm;
+
+std::atomic<bool> trace::detail::active { false };
+
+namespace
+{
+
+// per thread cap, about 100 MiB in total for a handful of busy threads
+constexpr usize MaxEvents { 1 << 20 };
+
+struct Event {
+    const char* name;
+    const char* cat;
+    i64         begin;
+    // -1 for instant
+    i64         dur;
+    u32         tid;
+    std::string detail;
+};
+
+struct Buffer : NoCopy {
+    // only contended while exporting
+    std::mutex         mutex;
+    std::vector<Event> events;
+    u32                tid;
+    std::string        name;
+    usize              dropped { 0 };
+};
+
+struct Registry {
+    std::mutex              mutex;
+    std::vector<rc<Buffer>> buffers;
+    u32                     next_tid { 1 };
+    i64                     origin { 0 };
+};
+
+Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+std::string current_thread_name() {
+#ifdef __linux__
+    char name[32] {};
+    if (pthread_getname_np(pthread_self(), name, sizeof(name)) == 0) return name;
+#endif
+    return {};
+}
+
+Buffer& local() {
+    // kept by the registry after the thread exits
+    thread_local rc<Buffer> buf = [] {
+        auto  b = std::make_shared<Buffer>();
+        auto& r = registry();
+        b->name = current_thread_name();
+
+        std::lock_guard lock { r.mutex };
+        b->tid = r.next_tid++;
+        r.buffers.push_back(b);
+        return b;
+    }();
+    return *buf;
+}
+
+void push(Event&& e) {
+    auto&           buf = local();
+    std::lock_guard lock { buf.mutex };
+    if (buf.events.size() >= MaxEvents) {
+        ++buf.dropped;
+        return;
+    }
+    buf.events.push_back(std::move(e));
+}
+
+void write_escaped(std::string& out, std::string_view s) {
+    for (char c : s) {
+        switch (c) {
+        case '"': out.append("\\\""); break;
+        case '\\': out.append("\\\\"); break;
+        case '\n': out.append("\\n"); break;
+        case '\t': out.append("\\t"); break;
+        default:
+            if ((unsigned char)c < 0x20)
+                fmt::format_to(std::back_inserter(out), "\\u{:04x}", (unsigned)c);
+            else
+                out.push_back(c);
+        }
+    }
+}
+
+} // namespace
+
+i64 trace::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+u32 trace::thread_id() { return local().tid; }
+
+void trace::start() {
+    auto& r = registry();
+    {
+        std::lock_guard lock { r.mutex };
+        for (auto& b : r.buffers) {
+            std::lock_guard buf_lock { b->mutex };
+            b->events.clear();
+            b->dropped = 0;
+        }
+        r.origin = now();
+    }
+    detail::active = true;
+}
+
+void trace::complete(const char* name, const char* cat, i64 begin, i64 end, u32 tid,
+                     std::string detail) {
+    if (! enabled()) return;
+    push(Event { name, cat, begin, std::max<i64>(end - begin, 0), tid, std::move(detail) });
+}
+
+void trace::instant(const char* name, const char* cat, std::string detail) {
+    if (! enabled()) return;
+    push(Event { name, cat, now(), -1, thread_id(), std::move(detail) });
+}
+
+bool trace::stop(std::string_view path) {
+    detail::active = false;
+
+    auto&       r = registry();
+    std::string out;
+    out.append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    bool first { true };
+    auto sep = [&first, &out] {
+        if (! first) out.append(",\n");
+        first = false;
+    };
+
+    std::lock_guard lock { r.mutex };
+    for (auto& b : r.buffers) {
+        std::lock_guard buf_lock { b->mutex };
+
+        sep();
+        out.append(fmt::format(
+            "{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":\"",
+            b->tid));
+        write_escaped(out, b->name.empty() ? fmt::format("thread {}", b->tid) : b->name);
+        out.append("\"}}");
+
+        for (auto& e : b->events) {
+            sep();
+            // chrome trace wants microseconds
+            auto ts = (double)(e.begin - r.origin) / 1000.0;
+            out.append("{\"name\":\"");
+            write_escaped(out, e.name);
+            out.append("\",\"cat\":\"");
+            write_escaped(out, e.cat);
+            if (e.dur >= 0) {
+                out.append(fmt::format("\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f}",
+                                       ts,
+                                       (double)e.dur / 1000.0));
+            } else {
+                out.append(fmt::format("\",\"ph\":\"i\",\"s\":\"t\",\"ts\":{:.3f}", ts));
+            }
+            out.append(fmt::format(",\"pid\":1,\"tid\":{}", e.tid));
+            if (! e.detail.empty()) {
+                out.append(",\"args\":{\"detail\":\"");
+                write_escaped(out, e.detail);
+                out.append("\"}");
+            }
+            out.push_back('}');
+        }
+        if (b->dropped) {
+            sep();
+            out.append(fmt::format("{{\"name\":\"dropped {} events\",\"ph\":\"i\",\"s\":\"t\","
+                                   "\"ts\":0,\"pid\":1,\"tid\":{}}}",
+                                   b->dropped,
+                                   b->tid));
+        }
+        b->events.clear();
+        b->events.shrink_to_fit();
+        b->dropped = 0;
+    }
+    out.append("\n]}\n");
+
+    auto f = std::fopen(std::string(path).c_str(), "wb");
+    if (! f) return false;
+    auto ok = std::fwrite(out.data(), 1, out.size(), f) == out.size();
+    return std::fclose(f) == 0 && ok;
+}
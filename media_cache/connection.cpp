@@ -10,6 +10,8 @@
 #include "request/response.h"
 
 #include "asio_helper/sync_file.h"
+#include "core/trace.h"
+#include "core/metrics.h"
 
 using namespace media_cache;
 
@@ -19,6 +21,31 @@ static constexpr auto             DigitPattern = ctll::fixed_string { "\\d*" };
 static constexpr std::string_view DlSuffix { ".download" };
 
 std::filesystem::path get_dl_path(std::filesystem::path p) { return p.replace_extension(DlSuffix); }
+
+struct Served {
+    qcm::metrics::Counter& disk;
+    qcm::metrics::Counter& network;
+};
+
+Served& served_bytes() {
+    static Served s {
+        qcm::metrics::counter("qcm_media_cache_served_bytes_total{source=\"disk\"}",
+                              "Bytes sent to the player."),
+        qcm::metrics::counter("qcm_media_cache_served_bytes_total{source=\"network\"}",
+                              "Bytes sent to the player."),
+    };
+    return s;
+}
+
+Served& connections() {
+    static Served s {
+        qcm::metrics::counter("qcm_media_cache_connections_total{source=\"disk\"}",
+                              "Player connections by source."),
+        qcm::metrics::counter("qcm_media_cache_connections_total{source=\"network\"}",
+                              "Player connections by source."),
+    };
+    return s;
+}
 } // namespace
 
 Connection::Connection(asio::ip::tcp::socket s, rc<DataBase> db): m_s(std::move(s)), m_db(db) {};
@@ -77,6 +104,7 @@ asio::awaitable<void> Connection::file_source(std::filesystem::path file_path) {
 
         co_await asio::async_write(
             m_s, asio::buffer((unsigned char*)buf.data(), size), asio::use_awaitable);
+        served_bytes().disk.inc(size);
 
         if (file.handle().eof()) break;
     }
@@ -84,6 +112,21 @@ asio::awaitable<void> Connection::file_source(std::filesystem::path file_path) {
     co_return;
 }
 
+asio::awaitable<void> Connection::metrics_source() {
+    auto body = qcm::metrics::render();
+
+    std::string rsp_header;
+    rsp_header.append("HTTP/1.1 200 OK\n");
+    rsp_header.append("Content-Type: text/plain; version=0.0.4\n");
+    rsp_header.append(fmt::format("Content-Length: {}\n", body.size()));
+    rsp_header.append("Connection: close\n");
+    rsp_header.append("\r\n");
+
+    std::array bufs { asio::buffer(rsp_header), asio::buffer(body) };
+    co_await asio::async_write(m_s, bufs, asio::use_awaitable);
+    co_return;
+}
+
 asio::awaitable<void> Connection::send_http_header(DataBase::Item&         db_item,
                                                    const request::Header&  header,
                                                    const request::Request& proxy_req) {
@@ -137,13 +180,18 @@ asio::awaitable<void> Connection::http_source(std::filesystem::path file_path,
         file.handle().seekg(m_req->range_start.value());
     }
 
+    qcm::trace::Span header_span { "media_cache.upstream_header", "media_cache" };
+    header_span.set_detail(proxy_id);
+
     auto rsp = (co_await ses->get(proxy_req)).value();
 
     DataBase::Item db_item;
     db_item.key = proxy_id;
     co_await send_http_header(db_item, rsp->header(), proxy_req);
+    header_span.end();
 
     bool finished { false };
+    bool first_chunk { true };
 
     auto check_finished = [&file_dl_path, &db_item, &file_path, &file, &rsp]() -> bool {
         if (auto cur_size = std::filesystem::file_size(file_dl_path);
@@ -177,6 +225,10 @@ asio::awaitable<void> Connection::http_source(std::filesystem::path file_path,
                                                         asio::as_tuple(asio::use_awaitable));
 
             co_await asio::async_write(m_s, asio::buffer(buf_data, size), asio::use_awaitable);
+            served_bytes().network.inc(size);
+            if (std::exchange(first_chunk, false)) {
+                qcm::trace::instant("media_cache.first_byte", "media_cache", proxy_id);
+            }
 
             file.write_some(asio::buffer(buf_data, size));
 
@@ -195,6 +247,7 @@ asio::awaitable<void> Connection::http_source(std::filesystem::path file_path,
             auto size = file.handle().gcount();
 
             co_await asio::async_write(m_s, asio::buffer(buf_data, size), asio::use_awaitable);
+            served_bytes().disk.inc(size);
 
             if (file.handle().eof()) break;
         }
@@ -207,14 +260,21 @@ asio::awaitable<void> Connection::run(rc<request::Session> ses, std::filesystem:
 
     DEBUG_LOG("connection started: {}", m_req->proxy_id.value_or(""));
 
-    if (req.proxy_id) {
+    qcm::trace::Span span { "media_cache.connection", "media_cache" };
+    span.set_detail(m_req->proxy_id.value_or(""));
+
+    if (req.path == "metrics") {
+        co_await metrics_source();
+    } else if (req.proxy_id) {
         auto proxy_id = req.proxy_id.value();
         std::filesystem::create_directories(cache_dir);
         auto file = cache_dir / proxy_id;
         if (co_await check_cache(proxy_id, file)) {
+            connections().disk.inc();
             std::filesystem::remove(get_dl_path(file));
             co_await file_source(file);
         } else if (req.proxy_url) {
+            connections().network.inc();
             co_await http_source(file, ses);
         }
     } else {
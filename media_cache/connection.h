@@ -25,6 +25,8 @@ public:
 private:
     asio::awaitable<void> http_source(std::filesystem::path, rc<request::Session>);
     asio::awaitable<void> file_source(std::filesystem::path);
+    // prometheus text format
+    asio::awaitable<void> metrics_source();
 
     asio::awaitable<void> send_http_header(DataBase::Item& db_item, const request::Header& header,
                                            const request::Request& proxy_req);
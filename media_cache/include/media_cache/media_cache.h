@@ -17,8 +17,11 @@ public:
 
     std::string get_url(std::string_view ori, std::string_view id) const;
 
-    void start(std::filesystem::path cache_dir, rc<DataBase>);
-    void stop();
+    void start(std::filesystem::path cache_dir, rc<DataBase>, u16 port = 0);
+    // prometheus metrics, served by the same listener
+    std::string metrics_url() const;
+    i32         port() const;
+    void        stop();
 
 private:
     rc<Server>            m_server;
@@ -20,7 +20,8 @@ public:
     Server(asio::any_io_executor ex, rc<request::Session>);
     ~Server();
 
-    void start(std::filesystem::path cache_dir, rc<DataBase>);
+    // port 0 picks a free one
+    void start(std::filesystem::path cache_dir, rc<DataBase>, u16 port = 0);
     void stop();
     i32  port() const;
 
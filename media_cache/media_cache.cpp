@@ -1,6 +1,7 @@
 #include "media_cache/media_cache.h"
 
 #include "core/log.h"
+#include "core/trace.h"
 
 #include "request/type.h"
 
@@ -10,13 +11,20 @@ MediaCache::MediaCache(asio::any_io_executor ex, rc<request::Session> s)
     : m_server(std::make_shared<Server>(ex, s)) {}
 MediaCache::~MediaCache() { stop(); }
 
-void MediaCache::start(std::filesystem::path cache_dir, rc<DataBase> db) {
-    m_server->start(cache_dir, db);
+void MediaCache::start(std::filesystem::path cache_dir, rc<DataBase> db, u16 port) {
+    m_server->start(cache_dir, db, port);
 }
 
 void MediaCache::stop() { m_server->stop(); }
 
+i32 MediaCache::port() const { return m_server->port(); }
+
+std::string MediaCache::metrics_url() const {
+    return fmt::format("http://127.0.0.1:{}/metrics", m_server->port());
+}
+
 std::string MediaCache::get_url(std::string_view ori, std::string_view id) const {
+    qcm::trace::instant("media_cache.get_url", "media_cache", std::string(id));
     request::UrlParams p;
     p.set_param("url", ori);
     return fmt::format("http://127.0.0.1:{}/{}?{}", m_server->port(), id, p.encode());
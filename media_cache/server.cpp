@@ -66,13 +66,19 @@ asio::awaitable<void> Server::listener(rc<DataBase> db) {
     co_return;
 }
 
-void Server::start(std::filesystem::path cache_dir, rc<DataBase> db) {
+void Server::start(std::filesystem::path cache_dir, rc<DataBase> db, u16 port) {
     m_cache_dir = cache_dir;
 
     auto addr = asio::ip::make_address_v4(asio::ip::address_v4::bytes_type { 127, 0, 0, 1 });
-    auto end  = asio::ip::tcp::endpoint(addr, 0);
+    auto end  = asio::ip::tcp::endpoint(addr, port);
     m_acceptor.open(end.protocol());
-    m_acceptor.bind(end);
+    m_acceptor.set_option(asio::ip::tcp::acceptor::reuse_address(true));
+    asio::error_code ec;
+    m_acceptor.bind(end, ec);
+    if (ec) {
+        WARN_LOG("can't bind port {}, {}", port, ec.message());
+        m_acceptor.bind(asio::ip::tcp::endpoint(addr, 0));
+    }
     m_acceptor.listen();
 
     auto local_end = m_acceptor.local_endpoint();
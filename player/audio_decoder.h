@@ -9,6 +9,7 @@ extern "C" {
 
 #include "core/core.h"
 #include "core/platform.h"
+#include "core/trace.h"
 #include "ffmpeg_frame.h"
 #include "stream_reader.h"
 #include "audio_frame_queue.h"
@@ -65,6 +66,7 @@ private:
     }
 
     const AVCodec* open_codec(AVCodecContext* ctx, StreamInfo& st_info) {
+        TRACE_SCOPE("decoder.open_codec", "player");
         auto idx = st_info.audio_idx;
         auto st  = st_info.st[idx];
 
@@ -93,6 +95,8 @@ private:
         FFmpegFrame   frame;
         FFmpegError   err       = AVERROR(EAGAIN);
         up<Resampler> resampler = make_up<Resampler>();
+        // first frame after start or seek
+        usize         traced_serial { 0 };
 
         auto err_skip = [](auto err) {
             return ! err || err == AVERROR(EAGAIN) || err == AVERROR_EOF;
@@ -123,6 +127,10 @@ private:
                 }
                 if (err) continue;
                 queue.push(std::move(out_frame));
+                if (qcm::trace::enabled() &&
+                    std::exchange(traced_serial, queue.serial()) != queue.serial()) {
+                    qcm::trace::instant("decoder.first_frame", "player");
+                }
             } else if (err == AVERROR_EOF) {
                 AudioFrame eof_frame;
                 eof_frame.set_eof();
@@ -14,8 +14,13 @@
 
 #include "core/core.h"
 #include "core/log.h"
+#include "core/trace.h"
+#include "core/metrics.h"
 #include "audio_frame_queue.h"
+#include "packet_queue.h"
+#include "dsp.h"
 #include "player/notify.h"
+#include "player/player.h"
 
 DEFINE_CONVERT(AVSampleFormat, cubeb_sample_format) {
     switch (in) {
@@ -121,8 +126,10 @@ private:
 
 class Device {
 public:
-    using Self                       = Device;
-    static constexpr u32 kBlockCount = 24;
+    using Self                        = Device;
+    static constexpr u32 kBlockCount  = 24;
+    // samples converted per gain pass, the callback buffer is processed in chunks
+    static constexpr usize kGainChunk = 4096;
 
     Device(rc<DeviceContext> ctx, cubeb_devid devid, i32 channels, i32 samplerate,
            Notifier notifier)
@@ -130,12 +137,12 @@ public:
         : m_ctx(ctx),
           m_stream(nullptr),
           m_channels(channels),
-          m_volume(1.0f),
           m_paused(false),
           m_mark_pos(0),
           m_mark_serial(-1),
           m_notifier(notifier),
-          m_last_pts(0) {
+          m_last_pts(0),
+          m_idle(true) {
         cubeb_stream_params output_params;
 
         output_params.rate     = samplerate;
@@ -165,6 +172,9 @@ public:
         }
 
         m_audio_params = convert_from<AudioParams>(output_params);
+        // allocate and pick kernels here, not in the callback
+        m_gain_buf.resize(kGainChunk / channels * channels);
+        dsp::kernels();
     };
     ~Device() {
         if (m_thread.joinable()) m_thread.join();
@@ -173,15 +183,34 @@ public:
     void start() { cubeb_stream_start(m_stream.get()); }
     void stop() { cubeb_stream_stop(m_stream.get()); }
 
-    bool set_volume(float v) const {
-        return CUBEB_OK == cubeb_stream_set_volume(m_stream.get(), v);
-    }
+    // software gain, ramped in the callback
+    void  set_volume(float v) { m_gain.set(std::clamp(v, 0.0f, 1.0f)); }
+    float volume() const { return m_gain.target(); }
 
-    void set_output(rc<AudioFrameQueue> in) {
+    // input is only used to tell decode from network underruns
+    void set_output(rc<AudioFrameQueue> in, rc<PacketQueue> input) {
         m_output_queue = in;
+        m_input_queue  = input;
         m_output_queue->set_audio_params(m_audio_params);
     }
 
+    DeviceStats stats() const {
+        auto&       s = m_stats;
+        DeviceStats out;
+        out.callbacks        = s.callbacks.load(std::memory_order_relaxed);
+        out.underruns        = s.underruns.load(std::memory_order_relaxed);
+        out.decode_underruns = s.decode_underruns.load(std::memory_order_relaxed);
+        out.input_underruns  = s.input_underruns.load(std::memory_order_relaxed);
+        out.late_callbacks   = s.late_callbacks.load(std::memory_order_relaxed);
+        out.silent_frames    = s.silent_frames.load(std::memory_order_relaxed);
+        out.cb_time_p50      = s.cb_time.quantile(0.5);
+        out.cb_time_p99      = s.cb_time.quantile(0.99);
+        out.cb_time_max      = s.cb_time_max.load(std::memory_order_relaxed);
+        out.queue_fill_p1    = s.queue_fill.quantile(0.01);
+        out.queue_fill_p50   = s.queue_fill.quantile(0.5);
+        return out;
+    }
+
     bool paused() const { return m_paused; }
     void set_pause(bool v) {
         m_paused = v;
@@ -225,11 +254,17 @@ private:
     }
 
     static long data_cb(cubeb_stream*, void* user, const void*, void* outputbuffer, long nframes) {
-        auto*      self = (Self*)user;
-        const auto size =
-            (usize)nframes * self->m_channels * self->m_audio_params.bytes_per_sample();
+        TRACE_SCOPE("device.data_cb", "player");
+        auto*      self  = (Self*)user;
+        auto       begin = std::chrono::steady_clock::now();
+        const auto frame_bytes =
+            (usize)self->m_channels * self->m_audio_params.bytes_per_sample();
+        const auto      size = (usize)nframes * frame_bytes;
         std::span<byte> output { (byte*)outputbuffer, size };
 
+        bool playing = ! self->paused() && ! self->m_idle;
+        if (playing) self->m_stats.queue_fill.observe(self->m_output_queue->approx_size());
+
         if (! self->dirty()) {
             auto& frame = self->m_cached_frame;
             if (! frame) {
@@ -238,6 +273,8 @@ private:
 
             while (frame && ! self->paused()) {
                 if (! frame->notified) self->notify(frame.value());
+                if (qcm::trace::enabled()) self->trace_first_audio();
+                self->m_idle = frame->frame.eof();
 
                 auto copied = std::min(output.size(), frame->data.size());
                 std::copy_n(frame->data.begin(), copied, output.begin());
@@ -249,16 +286,78 @@ private:
                 }
                 if (output.empty()) break;
             };
+            // nothing to play before the first frame and after eof
+            if (! output.empty() && ! self->paused() && ! self->m_idle) {
+                self->record_underrun(output.size() / frame_bytes);
+            }
         } else {
             self->m_output_queue->try_pop();
             self->m_cached_frame = std::nullopt;
+            self->m_idle         = true;
+        }
+
+        if (auto filled = size - output.size(); filled > 0) {
+            self->apply_gain({ (i16*)outputbuffer, filled / sizeof(i16) });
         }
 
         // silence
         std::fill(output.begin(), output.end(), byte {});
+
+        self->record_callback(begin, nframes, playing);
         return nframes;
     }
 
+    // output is s16, see the stream params
+    void apply_gain(std::span<i16> samples) {
+        if (m_gain.unity()) return;
+        auto& k = dsp::kernels();
+        while (! samples.empty()) {
+            auto n   = std::min(samples.size(), m_gain_buf.size());
+            auto buf = m_gain_buf.data();
+            k.s16_to_f32(buf, samples.data(), n);
+            m_gain.process(buf, n / m_channels, m_channels, m_audio_params.sample_rate);
+            k.f32_to_s16(samples.data(), buf, n, m_dither);
+            samples = samples.subspan(n);
+        }
+    }
+
+    void record_underrun(usize silent_frames) {
+        // packets waiting means the decoder is behind, otherwise the input is
+        bool decode = m_input_queue && m_input_queue->approx_size() > 0;
+        m_stats.underruns.fetch_add(1, std::memory_order_relaxed);
+        (decode ? m_stats.decode_underruns : m_stats.input_underruns)
+            .fetch_add(1, std::memory_order_relaxed);
+        m_stats.silent_frames.fetch_add(silent_frames, std::memory_order_relaxed);
+        (decode ? m_metrics.decode_underruns : m_metrics.input_underruns).inc();
+    }
+
+    void record_callback(std::chrono::steady_clock::time_point begin, long nframes,
+                         bool playing) {
+        auto end = std::chrono::steady_clock::now();
+        auto us  = (u64)std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+        m_stats.callbacks.fetch_add(1, std::memory_order_relaxed);
+        m_stats.cb_time.observe(us);
+        if (us > m_stats.cb_time_max.load(std::memory_order_relaxed))
+            m_stats.cb_time_max.store(us, std::memory_order_relaxed);
+        m_metrics.cb_time.observe(us);
+
+        // only while playing, a paused or stopped stream has nothing to be late for
+        auto period = std::chrono::microseconds(
+            (i64)nframes * 1000000 / std::max(m_audio_params.sample_rate, 1));
+        if (playing && m_last_cb && begin - *m_last_cb > period * 3 / 2) {
+            m_stats.late_callbacks.fetch_add(1, std::memory_order_relaxed);
+            m_metrics.late_callbacks.inc();
+        }
+        m_last_cb = begin;
+    }
+
+    void trace_first_audio() {
+        auto serial = m_output_queue->serial();
+        if (std::exchange(m_traced_serial, serial) != serial) {
+            qcm::trace::instant("device.first_audio", "player");
+        }
+    }
+
     static void state_cb(cubeb_stream* stream, void*, cubeb_state state) {
         if (! stream) return;
         switch (state) {
@@ -275,8 +374,12 @@ private:
     rc<DeviceContext> m_ctx;
     rc<cubeb_stream>  m_stream;
 
-    i32   m_channels;
-    float m_volume;
+    i32 m_channels;
+
+    // only touched by data_cb, except the gain target
+    dsp::Gain          m_gain;
+    dsp::Dither        m_dither;
+    std::vector<float> m_gain_buf;
 
     std::optional<Frame> m_cached_frame;
     std::atomic<bool>    m_paused;
@@ -287,6 +390,42 @@ private:
     rc<AudioFrameQueue> m_output_queue;
     Notifier            m_notifier;
     i64                 m_last_pts;
+    rc<PacketQueue>     m_input_queue;
+    // only touched by data_cb
+    usize               m_traced_serial { 0 };
+    bool                m_idle;
+
+    std::optional<std::chrono::steady_clock::time_point> m_last_cb;
+
+    // per device, read by stats()
+    struct Stats {
+        std::atomic<u64>        callbacks { 0 };
+        std::atomic<u64>        underruns { 0 };
+        std::atomic<u64>        decode_underruns { 0 };
+        std::atomic<u64>        input_underruns { 0 };
+        std::atomic<u64>        late_callbacks { 0 };
+        std::atomic<u64>        silent_frames { 0 };
+        std::atomic<u64>        cb_time_max { 0 };
+        qcm::metrics::Histogram cb_time;
+        // in frames, not microseconds
+        qcm::metrics::Histogram queue_fill;
+    } m_stats;
+
+    // process wide, for /metrics
+    struct Metrics {
+        qcm::metrics::Counter& decode_underruns {
+            qcm::metrics::counter("qcm_player_underruns_total{cause=\"decode\"}",
+                                  "Device callbacks that ran out of decoded audio.")
+        };
+        qcm::metrics::Counter& input_underruns {
+            qcm::metrics::counter("qcm_player_underruns_total{cause=\"input\"}",
+                                  "Device callbacks that ran out of decoded audio.")
+        };
+        qcm::metrics::Counter& late_callbacks { qcm::metrics::counter(
+            "qcm_player_late_callbacks_total", "Device callbacks later than 1.5 periods.") };
+        qcm::metrics::Histogram& cb_time { qcm::metrics::histogram(
+            "qcm_player_callback_seconds", "Device callback run time.") };
+    } m_metrics;
 };
 
 } // namespace player
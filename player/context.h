@@ -2,6 +2,7 @@
 
 #include "packet_queue.h"
 #include "audio_frame_queue.h"
+#include "core/metrics.h"
 
 namespace player
 {
@@ -9,7 +10,12 @@ namespace player
 struct Context {
     Context()
         : audio_pkt_queue(make_rc<PacketQueue>(4096)),
-          audio_frame_queue(make_rc<AudioFrameQueue>(32)) {}
+          audio_frame_queue(make_rc<AudioFrameQueue>(32)) {
+        audio_pkt_queue->set_depth_gauge(&qcm::metrics::gauge(
+            "qcm_player_queue_depth{queue=\"packet\"}", "Items in player queues."));
+        audio_frame_queue->set_depth_gauge(&qcm::metrics::gauge(
+            "qcm_player_queue_depth{queue=\"frame\"}", "Items in player queues."));
+    }
 
     ~Context() { set_aborted(true); }
 
@@ -0,0 +1,482 @@
+#include "dsp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "core/log.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#    define DSP_X86
+#    include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#    define DSP_NEON
+#    include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__)
+#    define DSP_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#    define DSP_TARGET_AVX2
+#endif
+
+using namespace player;
+using namespace player::dsp;
+
+namespace
+{
+
+constexpr float S16Scale { 32768.0f };
+constexpr float S16Min { -32768.0f };
+constexpr float S16Max { 32767.0f };
+constexpr float S32Scale { 1.0f / 2147483648.0f };
+// difference of the two 16 bit halves is triangular in (-1, 1)
+constexpr float NoiseScale { 1.0f / 65536.0f };
+
+namespace scalar
+{
+
+u32 next(u32& x) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+float noise(u32& x) {
+    auto r = next(x);
+    return (float)((i32)(r & 0xffff) - (i32)(r >> 16)) * NoiseScale;
+}
+
+void gain(float* buf, usize n, float g) {
+    for (usize i = 0; i < n; i++) buf[i] *= g;
+}
+
+void s16_to_f32(float* out, const i16* in, usize n) {
+    for (usize i = 0; i < n; i++) out[i] = in[i] * (1.0f / S16Scale);
+}
+
+void f32_to_s16(i16* out, const float* in, usize n, Dither& d) {
+    auto& x = d.state[0];
+    for (usize i = 0; i < n; i++) {
+        auto v = std::clamp(in[i] * S16Scale + noise(x), S16Min, S16Max);
+        out[i] = (i16)std::lrint(v);
+    }
+}
+
+void mono_to_stereo(float* out, const float* in, usize frames) {
+    for (usize i = 0; i < frames; i++) out[i * 2] = out[i * 2 + 1] = in[i];
+}
+
+void stereo_to_mono(float* out, const float* in, usize frames) {
+    for (usize i = 0; i < frames; i++) out[i] = (in[i * 2] + in[i * 2 + 1]) * 0.5f;
+}
+
+constexpr Kernels Table {
+    Isa::Scalar, gain, s16_to_f32, f32_to_s16, mono_to_stereo, stereo_to_mono,
+};
+
+} // namespace scalar
+
+#ifdef DSP_X86
+namespace sse2
+{
+
+__m128i next(__m128i x) {
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    return _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+}
+
+__m128 noise(__m128i r) {
+    auto lo = _mm_and_si128(r, _mm_set1_epi32(0xffff));
+    auto hi = _mm_srli_epi32(r, 16);
+    return _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(lo, hi)), _mm_set1_ps(NoiseScale));
+}
+
+void gain(float* buf, usize n, float g) {
+    auto  vg = _mm_set1_ps(g);
+    usize i  = 0;
+    for (; i + 4 <= n; i += 4) _mm_storeu_ps(buf + i, _mm_mul_ps(_mm_loadu_ps(buf + i), vg));
+    scalar::gain(buf + i, n - i, g);
+}
+
+void s16_to_f32(float* out, const i16* in, usize n) {
+    auto  scale = _mm_set1_ps(1.0f / S16Scale);
+    usize i     = 0;
+    for (; i + 8 <= n; i += 8) {
+        auto v = _mm_loadu_si128((const __m128i*)(in + i));
+        // sign extend by duplicating into the high half and shifting back
+        auto lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        auto hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    scalar::s16_to_f32(out + i, in + i, n - i);
+}
+
+void f32_to_s16(i16* out, const float* in, usize n, Dither& d) {
+    auto  scale = _mm_set1_ps(S16Scale);
+    auto  min   = _mm_set1_ps(S16Min);
+    auto  max   = _mm_set1_ps(S16Max);
+    auto  x     = _mm_load_si128((const __m128i*)d.state.data());
+    usize i     = 0;
+    for (; i + 8 <= n; i += 8) {
+        x      = next(x);
+        auto a = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), noise(x));
+        x      = next(x);
+        auto b = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale), noise(x));
+        a      = _mm_min_ps(_mm_max_ps(a, min), max);
+        b      = _mm_min_ps(_mm_max_ps(b, min), max);
+        auto s = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128((__m128i*)(out + i), s);
+    }
+    _mm_store_si128((__m128i*)d.state.data(), x);
+    scalar::f32_to_s16(out + i, in + i, n - i, d);
+}
+
+void mono_to_stereo(float* out, const float* in, usize frames) {
+    usize i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        auto v = _mm_loadu_ps(in + i);
+        _mm_storeu_ps(out + i * 2, _mm_unpacklo_ps(v, v));
+        _mm_storeu_ps(out + i * 2 + 4, _mm_unpackhi_ps(v, v));
+    }
+    scalar::mono_to_stereo(out + i * 2, in + i, frames - i);
+}
+
+void stereo_to_mono(float* out, const float* in, usize frames) {
+    auto  half = _mm_set1_ps(0.5f);
+    usize i    = 0;
+    for (; i + 4 <= frames; i += 4) {
+        auto a = _mm_loadu_ps(in + i * 2);
+        auto b = _mm_loadu_ps(in + i * 2 + 4);
+        auto l = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        auto r = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_add_ps(l, r), half));
+    }
+    scalar::stereo_to_mono(out + i, in + i * 2, frames - i);
+}
+
+constexpr Kernels Table {
+    Isa::Sse2, gain, s16_to_f32, f32_to_s16, mono_to_stereo, stereo_to_mono,
+};
+
+} // namespace sse2
+
+namespace avx2
+{
+
+DSP_TARGET_AVX2 __m256i next(__m256i x) {
+    x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+    return _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+}
+
+DSP_TARGET_AVX2 __m256 noise(__m256i r) {
+    auto lo = _mm256_and_si256(r, _mm256_set1_epi32(0xffff));
+    auto hi = _mm256_srli_epi32(r, 16);
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(lo, hi)),
+                         _mm256_set1_ps(NoiseScale));
+}
+
+DSP_TARGET_AVX2 void gain(float* buf, usize n, float g) {
+    auto  vg = _mm256_set1_ps(g);
+    usize i  = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(buf + i, _mm256_mul_ps(_mm256_loadu_ps(buf + i), vg));
+    scalar::gain(buf + i, n - i, g);
+}
+
+DSP_TARGET_AVX2 void s16_to_f32(float* out, const i16* in, usize n) {
+    auto  scale = _mm256_set1_ps(1.0f / S16Scale);
+    usize i     = 0;
+    for (; i + 8 <= n; i += 8) {
+        auto v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(in + i)));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    scalar::s16_to_f32(out + i, in + i, n - i);
+}
+
+DSP_TARGET_AVX2 void f32_to_s16(i16* out, const float* in, usize n, Dither& d) {
+    auto  scale = _mm256_set1_ps(S16Scale);
+    auto  min   = _mm256_set1_ps(S16Min);
+    auto  max   = _mm256_set1_ps(S16Max);
+    auto  x     = _mm256_load_si256((const __m256i*)d.state.data());
+    usize i     = 0;
+    for (; i + 16 <= n; i += 16) {
+        x      = next(x);
+        auto a = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i), scale), noise(x));
+        x      = next(x);
+        auto b = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i + 8), scale), noise(x));
+        a      = _mm256_min_ps(_mm256_max_ps(a, min), max);
+        b      = _mm256_min_ps(_mm256_max_ps(b, min), max);
+        // packs works per 128 bit lane, put the quarters back in order
+        auto s = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_permute4x64_epi64(s, 0xd8));
+    }
+    _mm256_store_si256((__m256i*)d.state.data(), x);
+    sse2::f32_to_s16(out + i, in + i, n - i, d);
+}
+
+// channel shuffles are memory bound, the sse2 ones are as fast
+constexpr Kernels Table {
+    Isa::Avx2, gain, s16_to_f32, f32_to_s16, sse2::mono_to_stereo, sse2::stereo_to_mono,
+};
+
+bool supported() {
+#    if defined(__GNUC__)
+    return __builtin_cpu_supports("avx2");
+#    else
+    return false;
+#    endif
+}
+
+} // namespace avx2
+#endif
+
+#ifdef DSP_NEON
+namespace neon
+{
+
+uint32x4_t next(uint32x4_t x) {
+    x = veorq_u32(x, vshlq_n_u32(x, 13));
+    x = veorq_u32(x, vshrq_n_u32(x, 17));
+    return veorq_u32(x, vshlq_n_u32(x, 5));
+}
+
+float32x4_t noise(uint32x4_t r) {
+    auto lo = vreinterpretq_s32_u32(vandq_u32(r, vdupq_n_u32(0xffff)));
+    auto hi = vreinterpretq_s32_u32(vshrq_n_u32(r, 16));
+    return vmulq_n_f32(vcvtq_f32_s32(vsubq_s32(lo, hi)), NoiseScale);
+}
+
+void gain(float* buf, usize n, float g) {
+    usize i = 0;
+    for (; i + 4 <= n; i += 4) vst1q_f32(buf + i, vmulq_n_f32(vld1q_f32(buf + i), g));
+    scalar::gain(buf + i, n - i, g);
+}
+
+void s16_to_f32(float* out, const i16* in, usize n) {
+    usize i = 0;
+    for (; i + 8 <= n; i += 8) {
+        auto v = vld1q_s16(in + i);
+        vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), 1.0f / S16Scale));
+        vst1q_f32(out + i + 4,
+                  vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), 1.0f / S16Scale));
+    }
+    scalar::s16_to_f32(out + i, in + i, n - i);
+}
+
+void f32_to_s16(i16* out, const float* in, usize n, Dither& d) {
+    auto  x = vld1q_u32(d.state.data());
+    usize i = 0;
+    for (; i + 8 <= n; i += 8) {
+        x      = next(x);
+        auto a = vaddq_f32(vmulq_n_f32(vld1q_f32(in + i), S16Scale), noise(x));
+        x      = next(x);
+        auto b = vaddq_f32(vmulq_n_f32(vld1q_f32(in + i + 4), S16Scale), noise(x));
+        // vcvtnq rounds to nearest, vqmovn saturates
+        auto s = vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)), vqmovn_s32(vcvtnq_s32_f32(b)));
+        vst1q_s16(out + i, s);
+    }
+    vst1q_u32(d.state.data(), x);
+    scalar::f32_to_s16(out + i, in + i, n - i, d);
+}
+
+void mono_to_stereo(float* out, const float* in, usize frames) {
+    usize i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        auto v = vld1q_f32(in + i);
+        vst2q_f32(out + i * 2, (float32x4x2_t { v, v }));
+    }
+    scalar::mono_to_stereo(out + i * 2, in + i, frames - i);
+}
+
+void stereo_to_mono(float* out, const float* in, usize frames) {
+    usize i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        auto v = vld2q_f32(in + i * 2);
+        vst1q_f32(out + i, vmulq_n_f32(vaddq_f32(v.val[0], v.val[1]), 0.5f));
+    }
+    scalar::stereo_to_mono(out + i, in + i * 2, frames - i);
+}
+
+constexpr Kernels Table {
+    Isa::Neon, gain, s16_to_f32, f32_to_s16, mono_to_stereo, stereo_to_mono,
+};
+
+} // namespace neon
+#endif
+
+// planar or non float input to interleaved float
+void to_float(float* out, const AVFrame* in, usize frames, usize channels, const Kernels& k) {
+    auto n = frames * channels;
+    switch ((AVSampleFormat)in->format) {
+    case AV_SAMPLE_FMT_S16: k.s16_to_f32(out, (const i16*)in->extended_data[0], n); break;
+    case AV_SAMPLE_FMT_S32: {
+        auto src = (const i32*)in->extended_data[0];
+        for (usize i = 0; i < n; i++) out[i] = src[i] * S32Scale;
+        break;
+    }
+    case AV_SAMPLE_FMT_FLTP:
+        for (usize c = 0; c < channels; c++) {
+            auto src = (const float*)in->extended_data[c];
+            for (usize i = 0; i < frames; i++) out[i * channels + c] = src[i];
+        }
+        break;
+    case AV_SAMPLE_FMT_S16P:
+        for (usize c = 0; c < channels; c++) {
+            auto src = (const i16*)in->extended_data[c];
+            for (usize i = 0; i < frames; i++) out[i * channels + c] = src[i] * (1.0f / S16Scale);
+        }
+        break;
+    case AV_SAMPLE_FMT_S32P:
+        for (usize c = 0; c < channels; c++) {
+            auto src = (const i32*)in->extended_data[c];
+            for (usize i = 0; i < frames; i++) out[i * channels + c] = src[i] * S32Scale;
+        }
+        break;
+    default: break;
+    }
+}
+
+} // namespace
+
+std::string_view dsp::to_sv(Isa isa) {
+    switch (isa) {
+    case Isa::Scalar: return "scalar";
+    case Isa::Sse2: return "sse2";
+    case Isa::Avx2: return "avx2";
+    case Isa::Neon: return "neon";
+    }
+    return "unknown";
+}
+
+Dither::Dither(u32 seed) {
+    // splitmix, xorshift must not start at 0
+    u64 x = seed;
+    for (auto& s : state) {
+        x += 0x9e3779b97f4a7c15;
+        u64 z = x;
+        z     = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z     = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        s     = (u32)(z ^ (z >> 31)) | 1;
+    }
+}
+
+const Kernels* dsp::kernels(Isa isa) {
+    switch (isa) {
+    case Isa::Scalar: return &scalar::Table;
+#ifdef DSP_X86
+    case Isa::Sse2: return &sse2::Table;
+    case Isa::Avx2: return avx2::supported() ? &avx2::Table : nullptr;
+#endif
+#ifdef DSP_NEON
+    case Isa::Neon: return &neon::Table;
+#endif
+    default: return nullptr;
+    }
+}
+
+const Kernels& dsp::kernels() {
+    static const Kernels& k = []() -> const Kernels& {
+        for (auto isa : { Isa::Avx2, Isa::Sse2, Isa::Neon }) {
+            if (auto p = kernels(isa)) {
+                DEBUG_LOG("dsp kernels: {}", to_sv(isa));
+                return *p;
+            }
+        }
+        return scalar::Table;
+    }();
+    return k;
+}
+
+void dsp::gain_ramp(float* buf, usize frames, usize channels, float from, float to) {
+    if (frames == 0) return;
+    auto step = (to - from) / frames;
+    for (usize f = 0; f < frames; f++) {
+        auto g = from + step * (f + 1);
+        for (usize c = 0; c < channels; c++) buf[f * channels + c] *= g;
+    }
+}
+
+void Gain::process(float* buf, usize frames, usize channels, i32 sample_rate) {
+    auto target = this->target();
+    if (m_current != target) {
+        // at most one full scale step per RampMs
+        auto max_step = 1.0f / std::max<i32>(sample_rate * RampMs / 1000, 1);
+        auto need     = (usize)std::ceil(std::abs(target - m_current) / max_step);
+        auto n        = std::min(frames, need);
+        auto to = n == need ? target : m_current + std::copysign(max_step * n, target - m_current);
+        gain_ramp(buf, n, channels, m_current, to);
+        m_current = to;
+        buf += n * channels;
+        frames -= n;
+    }
+    if (frames > 0 && m_current != 1.0f) kernels().gain(buf, frames * channels, m_current);
+}
+
+bool Converter::supported(const AVFrame* out, const AVFrame* in) {
+    if (in->sample_rate != out->sample_rate || in->nb_samples <= 0) return false;
+    switch (in->format) {
+    case AV_SAMPLE_FMT_FLT:
+    case AV_SAMPLE_FMT_FLTP:
+    case AV_SAMPLE_FMT_S16:
+    case AV_SAMPLE_FMT_S16P:
+    case AV_SAMPLE_FMT_S32:
+    case AV_SAMPLE_FMT_S32P: break;
+    default: return false;
+    }
+    if (out->format != AV_SAMPLE_FMT_S16 && out->format != AV_SAMPLE_FMT_FLT) return false;
+
+    auto in_ch  = in->ch_layout.nb_channels;
+    auto out_ch = out->ch_layout.nb_channels;
+    if (in_ch == out_ch) {
+        // surround needs the same channel order, anything else is left to swresample
+        return in_ch > 0 &&
+               (in_ch <= 2 || av_channel_layout_compare(&in->ch_layout, &out->ch_layout) == 0);
+    }
+    return (in_ch == 1 && out_ch == 2) || (in_ch == 2 && out_ch == 1);
+}
+
+int Converter::convert(AVFrame* out, const AVFrame* in) {
+    auto frames  = (usize)in->nb_samples;
+    auto in_ch   = (usize)in->ch_layout.nb_channels;
+    auto out_ch  = (usize)out->ch_layout.nb_channels;
+    auto in_fmt  = (AVSampleFormat)in->format;
+    auto out_fmt = (AVSampleFormat)out->format;
+
+    out->nb_samples = in->nb_samples;
+    if (int err = av_frame_get_buffer(out, 0); err < 0) return err;
+
+    if (in_fmt == out_fmt && in_ch == out_ch) {
+        auto bytes = frames * in_ch * av_get_bytes_per_sample(in_fmt);
+        std::memcpy(out->extended_data[0], in->extended_data[0], bytes);
+        return 0;
+    }
+
+    auto&        k = kernels();
+    const float* src { (const float*)in->extended_data[0] };
+    if (in_fmt != AV_SAMPLE_FMT_FLT) {
+        m_in.resize(frames * in_ch);
+        to_float(m_in.data(), in, frames, in_ch, k);
+        src = m_in.data();
+    }
+
+    if (in_ch != out_ch) {
+        m_mix.resize(frames * out_ch);
+        if (in_ch == 1)
+            k.mono_to_stereo(m_mix.data(), src, frames);
+        else
+            k.stereo_to_mono(m_mix.data(), src, frames);
+        src = m_mix.data();
+    }
+
+    if (out_fmt == AV_SAMPLE_FMT_S16) {
+        k.f32_to_s16((i16*)out->extended_data[0], src, frames * out_ch, m_dither);
+    } else {
+        std::memcpy(out->extended_data[0], src, frames * out_ch * sizeof(float));
+    }
+    return 0;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <string_view>
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+#include "core/core.h"
+
+// output path dsp, simd kernels picked at runtime
+//   scalar, sse2 and avx2 on x86_64, neon on aarch64
+// samples are interleaved, float is [-1, 1)
+namespace player::dsp
+{
+
+enum class Isa
+{
+    Scalar = 0,
+    Sse2,
+    Avx2,
+    Neon,
+};
+std::string_view to_sv(Isa);
+
+// xorshift32 per simd lane, for tpdf dither
+struct Dither {
+    Dither(u32 seed = 0x2545f491);
+    alignas(32) std::array<u32, 8> state;
+};
+
+struct Kernels {
+    Isa isa;
+    // buf *= gain
+    void (*gain)(float* buf, usize n, float gain);
+    void (*s16_to_f32)(float* out, const i16* in, usize n);
+    // tpdf dither of one lsb, then round and saturate
+    void (*f32_to_s16)(i16* out, const float* in, usize n, Dither&);
+    void (*mono_to_stereo)(float* out, const float* in, usize frames);
+    // average of both channels
+    void (*stereo_to_mono)(float* out, const float* in, usize frames);
+};
+
+// best one for this cpu
+const Kernels& kernels();
+// nullptr if not built in or not supported by this cpu
+const Kernels* kernels(Isa);
+
+// buf *= linear ramp from -> to, per frame
+void gain_ramp(float* buf, usize frames, usize channels, float from, float to);
+
+// software volume, ramps to a new value instead of jumping to it
+class Gain {
+public:
+    // full scale change takes this long
+    static constexpr i32 RampMs { 30 };
+
+    // any thread
+    void  set(float v) { m_target.store(v, std::memory_order_relaxed); }
+    float target() const { return m_target.load(std::memory_order_relaxed); }
+
+    // audio thread
+    bool unity() const { return m_current == 1.0f && target() == 1.0f; }
+    void process(float* buf, usize frames, usize channels, i32 sample_rate);
+
+private:
+    std::atomic<float> m_target { 1.0f };
+    float              m_current { 1.0f };
+};
+
+// format and channel conversion without resampling, for when swresample would only convert
+//   in   flt, fltp, s16, s16p, s32, s32p
+//   out  s16 or flt, interleaved
+//   same channels, or mono <-> stereo
+class Converter : NoCopy {
+public:
+    static bool supported(const AVFrame* out, const AVFrame* in);
+
+    // out has format, rate and layout set, its buffer is allocated here
+    int convert(AVFrame* out, const AVFrame* in);
+
+private:
+    std::vector<float> m_in;
+    std::vector<float> m_mix;
+    Dither             m_dither;
+};
+
+} // namespace player::dsp
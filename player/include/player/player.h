@@ -10,6 +10,30 @@
 namespace player
 {
 
+// audio callback health since the device was created
+struct DeviceStats {
+    u64 callbacks { 0 };
+    // callbacks that ran out of decoded audio while playing
+    u64 underruns { 0 };
+    // packets were waiting, decoding fell behind
+    u64 decode_underruns { 0 };
+    // no packets either, network or disk fell behind
+    u64 input_underruns { 0 };
+    // callbacks more than 1.5 periods after the previous one, scheduling
+    u64 late_callbacks { 0 };
+    // silence written for underruns
+    u64 silent_frames { 0 };
+
+    // callback run time, microseconds
+    u64 cb_time_p50 { 0 };
+    u64 cb_time_p99 { 0 };
+    u64 cb_time_max { 0 };
+
+    // decoded frames queued when a callback starts
+    u64 queue_fill_p1 { 0 };
+    u64 queue_fill_p50 { 0 };
+};
+
 class Player {
 public:
     class Private;
@@ -23,6 +47,13 @@ public:
 
     void set_source(std::string_view);
 
+    // linear, 0 to 1, ramped on the audio thread
+    void  set_volume(float);
+    float volume() const;
+
+    // lock free, callable from any thread
+    DeviceStats stats() const;
+
 private:
     C_DECLARE_PRIVATE(Player, m_d)
     up<Private> m_d;
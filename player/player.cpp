@@ -29,7 +29,7 @@ void Player::set_source(std::string_view v) {
 
     d->m_ctx->set_aborted(false);
 
-    d->m_dev->set_output(d->m_ctx->audio_frame_queue);
+    d->m_dev->set_output(d->m_ctx->audio_frame_queue, d->m_ctx->audio_pkt_queue);
     d->m_reader->start(v, d->m_ctx->audio_pkt_queue);
     d->m_dec->start(d->m_reader, d->m_ctx->audio_pkt_queue, d->m_ctx->audio_frame_queue);
 
@@ -37,6 +37,20 @@ void Player::set_source(std::string_view v) {
     play();
 }
 
+void Player::set_volume(float v) {
+    C_D(Player);
+    d->m_dev->set_volume(v);
+}
+float Player::volume() const {
+    C_D(const Player);
+    return d->m_dev->volume();
+}
+
+DeviceStats Player::stats() const {
+    C_D(const Player);
+    return d->m_dev->stats();
+}
+
 void Player::play() {
     C_D(Player);
     d->m_dev->set_pause(false);
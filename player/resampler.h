@@ -13,6 +13,7 @@ extern "C" {
 #include "audio_stream_params.h"
 #include "audio_frame.h"
 #include "ffmpeg_error.h"
+#include "dsp.h"
 
 namespace player
 {
@@ -31,6 +32,11 @@ public:
     }
 
     FFmpegError resampler(AudioFrame& out, const AudioFrame& in) {
+        // same rate, only format or channels differ, pts stays as copied from in
+        if (dsp::Converter::supported(out.ff.raw(), in.ff.raw())) {
+            if (is_inited()) close();
+            return FFmpegError(m_direct.convert(out.ff.raw(), in.ff.raw())).record();
+        }
         if (out.ff->pts != AV_NOPTS_VALUE) {
             double multiple_base = out.ff->sample_rate * in.ff->sample_rate;
             double  inpts         = in.ff->pts  * av_q2d(in.ff->time_base);
@@ -60,7 +66,8 @@ public:
     }
 
 private:
-    SwrContext* m_ctx;
+    SwrContext*    m_ctx;
+    dsp::Converter m_direct;
 };
 
 } // namespace player
@@ -13,6 +13,7 @@ extern "C" {
 #include "ffmpeg_format_context.h"
 #include "core/log.h"
 #include "core/platform.h"
+#include "core/trace.h"
 #include "ffmpeg_error.h"
 #include "packet_queue.h"
 #include "player/notify.h"
@@ -86,6 +87,8 @@ private:
 
         FFmpegError err;
         {
+            qcm::trace::Span span { "reader.open_input", "player" };
+            span.set_detail(m_url);
             FFmpegDict opt;
             opt.set("reconnect", 1);
             err = fmt_ctx.open_input(m_url.c_str(), std::move(opt));
@@ -94,7 +97,10 @@ private:
             ERROR_LOG("{}, url: {}", err.what(), m_url);
             return;
         }
-        err = fmt_ctx.find_stream_info(NULL);
+        {
+            TRACE_SCOPE("reader.find_stream_info", "player");
+            err = fmt_ctx.find_stream_info(NULL);
+        }
         if (err) {
             ERROR_LOG("{}", err.what());
             return;
@@ -130,6 +136,7 @@ private:
         }
 
         Packet pkt;
+        bool   first_pkt { true };
         // read pkt
         for (;;) {
             while (m_eof && ! m_aborted) {
@@ -190,6 +197,9 @@ private:
                 }
                 if (st_idx == audio_idx) {
                     if (! pkt_queue.push(std::move(pkt_ref).value())) continue;
+                    if (std::exchange(first_pkt, false)) {
+                        qcm::trace::instant("reader.first_packet", "player");
+                    }
                 }
             } else {
                 ERROR_LOG("{}", pkt_ref.error().what());
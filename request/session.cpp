@@ -17,6 +17,9 @@
 
 #include "connection.h"
 
+#include "core/trace.h"
+#include "core/metrics.h"
+
 using namespace request;
 
 constexpr static auto POLL_TIMEOUT { std::chrono::milliseconds(1000) };
@@ -33,6 +36,25 @@ T get_curl_private(CURL* c) {
     return easy;
 }
 
+void record_transfer(CurlEasy& easy, CURLcode result) {
+    namespace metrics = qcm::metrics;
+    constexpr std::string_view help { "Finished transfers." };
+    static auto& ok     = metrics::counter("qcm_request_total{result=\"ok\"}", help);
+    static auto& failed = metrics::counter("qcm_request_total{result=\"error\"}", help);
+    static auto& total  = metrics::histogram("qcm_request_duration_seconds",
+                                            "Transfer time from start to the last byte.");
+    static auto& first  = metrics::histogram("qcm_request_first_byte_seconds",
+                                            "Transfer time from start to the first byte.");
+    static auto& bytes  = metrics::counter("qcm_request_received_bytes_total", "Bytes received.");
+
+    (result == CURLE_OK ? ok : failed).inc();
+    // all in microseconds
+    if (auto t = easy.get_info<curl_off_t>(CURLINFO_TOTAL_TIME_T)) total.observe((u64)*t);
+    if (auto t = easy.get_info<curl_off_t>(CURLINFO_STARTTRANSFER_TIME_T); t && *t > 0)
+        first.observe((u64)*t);
+    if (auto n = easy.get_info<curl_off_t>(CURLINFO_SIZE_DOWNLOAD_T)) bytes.inc((u64)*n);
+}
+
 } // namespace
 
 Session::Session(executor_type ex): m_p(std::make_unique<Private>(*this, ex)) {
@@ -82,6 +104,9 @@ asio::awaitable<bool> Session::perform(rc<Response>& rsp) {
     auto& con = rsp->connection();
     rsp->prepare_perform();
 
+    qcm::trace::Span span { "request.header", "request" };
+    span.set_detail(con.url());
+
     sm::ConnectAction msg {
         .con    = con.get_rc(),
         .action = sm::ConnectAction::Action::Add,
@@ -184,6 +209,7 @@ asio::awaitable<void> Session::Private::run() {
         for (auto& m : infos) {
             if (m.msg != CURLMSG_DONE) continue;
             auto con = get_curl_private<Connection*>(m.easy_handle)->get_rc();
+            record_transfer(con->easy(), m.result);
             con->finish(m.result);
             remove_connect(con);
             running_connect--;
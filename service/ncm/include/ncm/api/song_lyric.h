@@ -38,6 +38,8 @@ struct SongLyric {
     std::optional<model::SongLyricItem> klyric;
     std::optional<model::SongLyricItem> tlyric;
     std::optional<model::SongLyricItem> romalrc;
+    // word timed
+    std::optional<model::SongLyricItem> yrc;
 };
 JSON_DEFINE(SongLyric);
 
@@ -65,6 +67,7 @@ struct SongLyric {
         p["lv"] = "-1";
         p["rv"] = "-1";
         p["kv"] = "-1";
+        p["yv"] = "-1";
         return p;
     }
     in_type input;